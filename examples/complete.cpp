@@ -110,6 +110,15 @@ int main()
                 "hello_everysession",
                 [](std::ostream&){ Cli::cout() << "Hello, everybody" << std::endl; },
                 "Print hello everybody on all open sessions" );
+        rootMenu->Insert(
+                "numbers",
+                [](std::ostream& out, int n)
+                {
+                    auto i = std::make_shared<int>(0);
+                    // the lines are produced only when the user asks for them
+                    Paginate(out, [i, n](std::ostream& o){ o << (*i)++ << "\n"; return *i < n; });
+                },
+                "Print the numbers from 0 to n-1, one screen at a time" );
         rootMenu->Insert(
                 "answer",
                 [](std::ostream& out, int x){ out << "The answer is: " << x << "\n"; },
@@ -267,6 +276,8 @@ int main()
         CliTelnetServer server(cli, scheduler, 5000);
         // exit action for all the connections
         server.ExitAction( [](auto& out) { out << "Terminating this session...\n"; } );
+        // long outputs are shown one screen at a time
+        server.Pager(24);
 
         scheduler.Run();
 
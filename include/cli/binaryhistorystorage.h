@@ -0,0 +1,385 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#ifndef CLI_BINARYHISTORYSTORAGE_H_
+#define CLI_BINARYHISTORYSTORAGE_H_
+
+#include "historystorage.h"
+#include "detail/crc32.h"
+#include <fstream>
+#include <cstdio> // std::rename, std::remove
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace cli
+{
+
+/**
+ * @brief BinaryHistoryStorage is a persistent history storage that saves the commands
+ * in a binary file of length-prefixed records.
+ * Every record carries the time the command was stored and a tag (e.g., the user
+ * or the session that issued the command), and is protected by a CRC: commands
+ * can contain any character (newlines too) and a torn write is detected and
+ * discarded when the file is loaded.
+ * Every record ends with its own size, so the newest records are loaded by seeking
+ * backward from the end of the file, without reading the whole file.
+ * The payload of a record is at most 16 MiB: a longer command is not stored.
+ *
+ * Record layout (integers are little endian):
+ *   - magic (4 bytes): "CLIH"
+ *   - payload size (4 bytes)
+ *   - payload:
+ *       - time (8 bytes): milliseconds since the epoch, 0 if unknown
+ *       - tag size (2 bytes)
+ *       - tag
+ *       - command
+ *   - crc (4 bytes): CRC-32 of the payload size and the payload
+ *   - record size (4 bytes)
+ */
+class BinaryHistoryStorage : public HistoryStorage
+{
+public:
+
+    struct Record
+    {
+        std::chrono::system_clock::time_point time;
+        std::string tag;
+        std::string command;
+    };
+
+    /**
+     * @brief Construct a new BinaryHistoryStorage object.
+     *
+     * @param _fileName the name of the file where the history is saved
+     * @param size the number of commands loaded
+     * @param _tag the tag of the records stored by this object
+     */
+    explicit BinaryHistoryStorage(std::string _fileName, std::size_t size = 1000, std::string _tag = {}) :
+        maxSize(size),
+        fileName(std::move(_fileName)),
+        tag(std::move(_tag))
+    {
+    }
+
+    void Store(const std::vector<std::string>& cmds) override
+    {
+        Store(cmds, tag);
+    }
+
+    // The records are tagged with the identity of the session, if any
+    void StoreFor(const std::string& identity, const std::vector<std::string>& cmds) override
+    {
+        if (identity.empty())
+            Store(cmds);
+        else
+            Store(cmds, identity);
+    }
+
+    std::vector<std::string> Commands() const override
+    {
+        auto records = Records(maxSize);
+        std::vector<std::string> commands;
+        commands.reserve(records.size());
+        for (auto& r: records)
+            commands.push_back(std::move(r.command));
+        return commands;
+    }
+
+    void Clear() override
+    {
+        std::ofstream f(fileName, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        numRecords = 0;
+    }
+
+    /**
+     * @brief Returns the newest records of the file, the oldest first.
+     * If the end of the file is corrupted (e.g., because of a partial write),
+     * the records before the corruption are returned.
+     *
+     * @param n the maximum number of records to return
+     */
+    std::vector<Record> Records(std::size_t n) const
+    {
+        std::ifstream in(fileName, std::ios_base::in | std::ios_base::binary);
+        if (!in)
+            return {};
+        std::vector<Record> result;
+        if (!ReadBackward(in, n, result))
+            result = ReadForward(in, n);
+        return result;
+    }
+
+    /**
+     * @brief Appends the commands of a text history file (i.e., the format of @c FileHistoryStorage).
+     * The text format doesn't save the time of the commands, so it's left unknown (the epoch).
+     *
+     * @param textFileName the name of the text history file
+     * @return false if the text file cannot be opened
+     */
+    bool ImportTextFile(const std::string& textFileName)
+    {
+        std::ifstream in(textFileName);
+        if (!in)
+            return false;
+        std::vector<Record> records;
+        std::string line;
+        while (std::getline(in, line))
+            records.push_back(Record{{}, tag, line});
+        Append(records);
+        return true;
+    }
+
+private:
+
+    static constexpr std::uint32_t magic = 0x48494C43; // "CLIH" in little endian
+    static constexpr std::size_t headerSize = 8; // magic + payload size
+    static constexpr std::size_t trailerSize = 8; // crc + record size
+    static constexpr std::size_t minPayloadSize = 10; // time + tag size
+    static constexpr std::size_t maxPayloadSize = 1 << 24; // sanity check against corrupted sizes
+    static constexpr std::size_t minRecordSize = headerSize + minPayloadSize + trailerSize;
+    static constexpr std::size_t corrupted = static_cast<std::size_t>(-1); // never the size of a record
+    static constexpr std::size_t unknown = static_cast<std::size_t>(-1);
+
+    void Store(const std::vector<std::string>& cmds, const std::string& recordTag)
+    {
+        const auto now = std::chrono::system_clock::now();
+        std::vector<Record> records;
+        records.reserve(cmds.size());
+        for (const auto& c: cmds)
+            records.push_back(Record{now, recordTag, c});
+        Append(records);
+    }
+
+    // the file is compacted when it contains more than twice the records to load
+    void Append(const std::vector<Record>& records)
+    {
+        if (records.empty())
+            return;
+        if (numRecords == unknown)
+            Check();
+        std::size_t encoded = 0;
+        {
+            std::string buffer;
+            for (const auto& r: records)
+                if (Encode(r, buffer))
+                    ++encoded;
+            std::ofstream out(fileName, std::ios_base::out | std::ios_base::binary | std::ios_base::app);
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        }
+        numRecords += encoded;
+        if (numRecords > 2*maxSize)
+            Rewrite(Records(maxSize));
+    }
+
+    // Counts the records of the file and repairs its tail, if needed.
+    void Check()
+    {
+        std::ifstream in(fileName, std::ios_base::in | std::ios_base::binary);
+        if (!in)
+        {
+            numRecords = 0;
+            return;
+        }
+        std::vector<Record> records;
+        if (!ReadBackward(in, 2*maxSize+1, records))
+        {
+            in.close();
+            Rewrite(Records(maxSize));
+        }
+        else
+            numRecords = records.size();
+    }
+
+    void Rewrite(const std::vector<Record>& records)
+    {
+        const std::string tmpName = fileName + ".tmp";
+        {
+            std::string buffer;
+            for (const auto& r: records)
+                Encode(r, buffer);
+            std::ofstream out(tmpName, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        }
+        if (std::rename(tmpName.c_str(), fileName.c_str()) != 0)
+        {
+            // on windows rename fails if the destination exists
+            std::remove(fileName.c_str());
+            std::rename(tmpName.c_str(), fileName.c_str());
+        }
+        numRecords = records.size();
+    }
+
+    // Reads up to n records starting from the end of the file.
+    // Returns false if a corrupted record is found.
+    static bool ReadBackward(std::istream& in, std::size_t n, std::vector<Record>& result)
+    {
+        in.seekg(0, std::ios_base::end);
+        auto pos = static_cast<std::size_t>(in.tellg());
+        std::vector<Record> reversed;
+        while (pos > 0 && reversed.size() < n)
+        {
+            if (pos < minRecordSize)
+                return false;
+            char sizeBuf[4];
+            in.seekg(static_cast<std::streamoff>(pos - 4));
+            if (!in.read(sizeBuf, 4))
+                return false;
+            const std::size_t size = GetU32(sizeBuf);
+            if (size < minRecordSize || size > pos)
+                return false;
+            in.seekg(static_cast<std::streamoff>(pos - size));
+            Record r;
+            if (ReadRecord(in, r) != size)
+                return false;
+            reversed.push_back(std::move(r));
+            pos -= size;
+        }
+        result.assign(std::make_move_iterator(reversed.rbegin()), std::make_move_iterator(reversed.rend()));
+        return true;
+    }
+
+    // Reads the file from the beginning up to the first corrupted record,
+    // and returns the last n records read.
+    static std::vector<Record> ReadForward(std::istream& in, std::size_t n)
+    {
+        in.clear();
+        in.seekg(0);
+        std::deque<Record> records;
+        Record r;
+        while (ReadRecord(in, r) != corrupted)
+        {
+            records.push_back(std::move(r));
+            if (records.size() > n)
+                records.pop_front();
+        }
+        return std::vector<Record>(std::make_move_iterator(records.begin()), std::make_move_iterator(records.end()));
+    }
+
+    // Reads the record at the current position.
+    // Returns the size of the record, or corrupted.
+    static std::size_t ReadRecord(std::istream& in, Record& r)
+    {
+        char header[headerSize];
+        if (!in.read(header, headerSize) || GetU32(header) != magic)
+            return corrupted;
+        const std::size_t payloadSize = GetU32(header+4);
+        if (payloadSize < minPayloadSize || payloadSize > maxPayloadSize)
+            return corrupted;
+        std::string payload(payloadSize + trailerSize, '\0');
+        if (!in.read(&payload[0], static_cast<std::streamsize>(payload.size())))
+            return corrupted;
+        const char* trailer = payload.data() + payloadSize;
+        auto crc = detail::Crc32(header+4, 4);
+        crc = detail::Crc32(payload.data(), payloadSize, crc);
+        if (crc != GetU32(trailer))
+            return corrupted;
+        const std::size_t size = GetU32(trailer+4);
+        if (size != headerSize + payloadSize + trailerSize)
+            return corrupted;
+        const std::size_t tagSize = GetU16(payload.data()+8);
+        if (minPayloadSize + tagSize > payloadSize)
+            return corrupted;
+        r.time = std::chrono::system_clock::time_point(std::chrono::milliseconds(static_cast<long long>(GetU64(payload.data()))));
+        r.tag.assign(payload.data() + minPayloadSize, tagSize);
+        r.command.assign(payload.data() + minPayloadSize + tagSize, payloadSize - minPayloadSize - tagSize);
+        return size;
+    }
+
+    // Appends the record to buffer, unless its payload is too large to be read back
+    // (in that case returns false)
+    static bool Encode(const Record& r, std::string& buffer)
+    {
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(r.time.time_since_epoch()).count();
+        const std::size_t tagSize = std::min<std::size_t>(r.tag.size(), 0xFFFF);
+        const std::size_t payloadSize = minPayloadSize + tagSize + r.command.size();
+        if (payloadSize > maxPayloadSize)
+            return false;
+        const auto start = buffer.size();
+        PutU32(buffer, magic);
+        PutU32(buffer, static_cast<std::uint32_t>(payloadSize));
+        PutU64(buffer, static_cast<std::uint64_t>(ms));
+        PutU16(buffer, static_cast<std::uint16_t>(tagSize));
+        buffer.append(r.tag, 0, tagSize);
+        buffer.append(r.command);
+        const auto crc = detail::Crc32(buffer.data() + start + 4, 4 + payloadSize);
+        PutU32(buffer, crc);
+        PutU32(buffer, static_cast<std::uint32_t>(headerSize + payloadSize + trailerSize));
+        return true;
+    }
+
+    static void PutU16(std::string& b, std::uint16_t v)
+    {
+        for (int i = 0; i < 2; ++i)
+            b += static_cast<char>((v >> (8*i)) & 0xFF);
+    }
+    static void PutU32(std::string& b, std::uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            b += static_cast<char>((v >> (8*i)) & 0xFF);
+    }
+    static void PutU64(std::string& b, std::uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            b += static_cast<char>((v >> (8*i)) & 0xFF);
+    }
+    static std::uint16_t GetU16(const char* p)
+    {
+        const auto* u = reinterpret_cast<const unsigned char*>(p);
+        return static_cast<std::uint16_t>(u[0] | (u[1] << 8));
+    }
+    static std::uint32_t GetU32(const char* p)
+    {
+        const auto* u = reinterpret_cast<const unsigned char*>(p);
+        std::uint32_t v = 0;
+        for (int i = 3; i >= 0; --i)
+            v = (v << 8) | u[i];
+        return v;
+    }
+    static std::uint64_t GetU64(const char* p)
+    {
+        const auto* u = reinterpret_cast<const unsigned char*>(p);
+        std::uint64_t v = 0;
+        for (int i = 7; i >= 0; --i)
+            v = (v << 8) | u[i];
+        return v;
+    }
+
+    const std::size_t maxSize;
+    const std::string fileName;
+    const std::string tag;
+    std::size_t numRecords = unknown; // number of records in the file
+};
+
+} // namespace cli
+
+#endif // CLI_BINARYHISTORYSTORAGE_H_
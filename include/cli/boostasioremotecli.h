@@ -34,6 +34,10 @@
 #include "detail/genericasioremotecli.h"
 
 namespace cli { using BoostAsioCliTelnetServer = detail::CliGenericTelnetServer<detail::BoostAsioLib>; }
+namespace cli { using BoostAsioCliMachineServer = detail::CliGenericMachineServer<detail::BoostAsioLib>; }
+#ifdef CLI_DETAIL_LOCAL_SOCKETS
+namespace cli { using BoostAsioCliLocalServer = detail::CliGenericLocalServer<detail::BoostAsioLib>; }
+#endif
 
 #endif // CLI_BOOSTASIOREMOTECLI_H_
 
@@ -39,12 +39,19 @@
 #include <type_traits>
 #include "colorprofile.h"
 #include "detail/history.h"
+#include "detail/sharedhistory.h"
+#include "detail/suggestionindex.h"
 #include "detail/split.h"
 #include "detail/fromstring.h"
+#include "detail/outputsink.h"
+#include "scheduler.h"
 #include "historystorage.h"
 #include "volatilehistorystorage.h"
 #include <iostream>
+#include <sstream>
 #include <utility>
+#include <mutex>
+#include <thread>
 
 namespace cli
 {
@@ -73,6 +80,12 @@ namespace cli
     // ********************************************************************
 
     // this class provides a global output stream
+    // The output is broadcast to the registered streams one line at a time
+    // (or when the stream is flushed): every line is written once in a shared
+    // immutable buffer, that the streams of the remote sessions queue without copying.
+    // It can be used by any thread: each thread builds its lines in its own buffer,
+    // so that the lines of different threads are never mixed up, and the output is
+    // written in the thread of the scheduler of the stream, if any (see Register).
     class OutStream : public std::basic_ostream<char>, public std::streambuf
     {
     public:
@@ -83,29 +96,159 @@ namespace cli
         // std::streambuf overrides
         std::streamsize xsputn(const char* s, std::streamsize n) override
         {
-            for (auto os: ostreams)
-                os->rdbuf()->sputn(s, n);
+            auto& buffer = LineBuffer();
+            buffer.append(s, static_cast<std::size_t>(n));
+            if (std::char_traits<char>::find(s, static_cast<std::size_t>(n), '\n') != nullptr)
+                Broadcast(buffer.rfind('\n') + 1);
             return n;
         }
         int overflow(int c) override
         {
-            for (auto os: ostreams)
-                *os << static_cast<char>(c);
+            if (std::streambuf::traits_type::eq_int_type(c, std::streambuf::traits_type::eof()))
+                return std::streambuf::traits_type::not_eof(c);
+            auto& buffer = LineBuffer();
+            buffer += static_cast<char>(c);
+            if (c == '\n')
+                Broadcast(buffer.size());
             return c;
-        }            
+        }
+        int sync() override
+        {
+            Broadcast(LineBuffer().size());
+            return 0;
+        }
 
-        void Register(std::ostream& o)
+        /**
+         * @brief Add a stream to the destinations of the output.
+         *
+         * @param o the stream
+         * @param scheduler if not null, the output is written on @c o in the thread of this scheduler
+         * (the stream can be used without locks by the tasks of the scheduler).
+         * Otherwise, it's written by the thread producing it.
+         */
+        void Register(std::ostream& o, Scheduler* scheduler = nullptr)
         {
-            ostreams.push_back(&o);
+            auto target = std::make_shared<Target>(o, scheduler);
+            {
+                std::lock_guard<std::mutex> lock(targetsMutex);
+                auto newTargets = std::make_shared<Targets>(*targets);
+                newTargets->push_back(target);
+                targets = std::move(newTargets);
+            }
+            if (scheduler)
+            {
+                std::lock_guard<std::mutex> lock(target->mutex);
+                Post(target); // to learn the thread of the scheduler
+            }
         }
+        // After this method returns, the stream is not used anymore
         void UnRegister(std::ostream& o)
         {
-            ostreams.erase(std::remove(ostreams.begin(), ostreams.end(), &o), ostreams.end());
+            Targets removed;
+            {
+                std::lock_guard<std::mutex> lock(targetsMutex);
+                auto newTargets = std::make_shared<Targets>();
+                for (const auto& t: *targets)
+                    (t->os == &o ? removed : *newTargets).push_back(t);
+                targets = std::move(newTargets);
+            }
+            for (const auto& t: removed)
+            {
+                std::lock_guard<std::mutex> lock(t->mutex);
+                t->registered = false;
+                t->pending.clear();
+            }
         }
 
     private:
 
-        std::vector<std::ostream*> ostreams;
+        using Text = std::shared_ptr<const std::string>;
+
+        struct Target
+        {
+            Target(std::ostream& o, Scheduler* s) :
+                os(&o), sink(dynamic_cast<detail::OutputSink*>(o.rdbuf())), scheduler(s) {}
+            std::ostream* const os;
+            detail::OutputSink* const sink; // not null if os can take shared buffers
+            Scheduler* const scheduler;
+            std::mutex mutex; // protects the members below and the use of os
+            bool registered = true;
+            std::vector<Text> pending; // the lines waiting for the scheduler
+            bool drainPosted = false;
+            std::thread::id schedulerThread;
+        };
+        using Targets = std::vector<std::shared_ptr<Target>>;
+
+        // the line buffer of the calling thread
+        static std::string& LineBuffer()
+        {
+            thread_local std::string buffer;
+            return buffer;
+        }
+
+        // sends the first n characters of the line buffer to every stream
+        void Broadcast(std::size_t n)
+        {
+            if (n == 0)
+                return;
+            auto& buffer = LineBuffer();
+            const auto text = std::make_shared<const std::string>(buffer, 0, n);
+            buffer.erase(0, n);
+
+            std::shared_ptr<const Targets> snapshot;
+            {
+                std::lock_guard<std::mutex> lock(targetsMutex);
+                snapshot = targets;
+            }
+            for (const auto& t: *snapshot)
+                Deliver(t, text);
+        }
+
+        static void Deliver(const std::shared_ptr<Target>& t, const Text& text)
+        {
+            std::lock_guard<std::mutex> lock(t->mutex);
+            if (!t->registered)
+                return;
+            if (t->sink)
+                t->sink->Deliver(text); // thread safe and never blocking
+            else if (t->scheduler == nullptr || t->schedulerThread == std::this_thread::get_id())
+            {
+                t->pending.push_back(text);
+                Write(*t);
+            }
+            else
+            {
+                t->pending.push_back(text);
+                if (!t->drainPosted)
+                    Post(t);
+            }
+        }
+
+        // NB: t->mutex must be locked
+        static void Write(Target& t)
+        {
+            for (const auto& text: t.pending)
+                t.os->write(text->data(), static_cast<std::streamsize>(text->size()));
+            t.pending.clear();
+            t.os->flush();
+        }
+
+        // writes the pending lines in the thread of the scheduler
+        static void Post(const std::shared_ptr<Target>& t)
+        {
+            t->drainPosted = true;
+            t->scheduler->Post([t]()
+            {
+                std::lock_guard<std::mutex> lock(t->mutex);
+                t->drainPosted = false;
+                t->schedulerThread = std::this_thread::get_id();
+                if (t->registered && !t->pending.empty())
+                    Write(*t);
+            });
+        }
+
+        std::mutex targetsMutex;
+        std::shared_ptr<const Targets> targets = std::make_shared<const Targets>();
     };
     
     // forward declarations
@@ -134,11 +277,15 @@ namespace cli
          *   - @c VolatileHistoryStorage
          *   - @c FileHistoryStorage it's a persistent history. I.e., the command history is preserved after your application
          *     is restarted.
+         *   - @c BinaryHistoryStorage it's a persistent history saved in a binary file, where each command has a timestamp
+         *     and a tag, and is protected by a checksum.
          * 
          * However, you can develop your own, just derive a class from @c HistoryStorage .
          */
         Cli(std::unique_ptr<Menu> _rootMenu, std::unique_ptr<HistoryStorage> historyStorage = std::make_unique<VolatileHistoryStorage>()) :
             globalHistoryStorage(std::move(historyStorage)),
+            sharedHistory(std::make_unique<detail::SharedHistory>()),
+            sharedSuggestions(std::make_unique<detail::SharedSuggestions>()),
             rootMenu(std::move(_rootMenu)),
             exitAction{}
         {
@@ -151,6 +298,26 @@ namespace cli
          */
         void ExitAction(const std::function< void(std::ostream&)>& action) { exitAction = action; }
 
+        /**
+         * @brief Set the policy for the commands issued again in the history of the sessions.
+         * With @c HistoryDuplicates::eraseOlder only the newest occurrence of a command is kept,
+         * otherwise (default) only the consecutive repetitions are dropped.
+         * It affects the sessions created after the call.
+         * To apply the same policy to the global history, pass it also to the @c HistoryStorage constructor.
+         *
+         * @param d the policy for duplicated commands
+         */
+        void HistoryDuplicatesPolicy(HistoryDuplicates d) { historyDuplicates = d; }
+
+        /**
+         * @brief Enable the inline suggestions in the interactive sessions created after the call.
+         * While typing, the most likely completion from the history (ranked by frequency and recency)
+         * is shown in gray after the cursor, and it can be accepted with the right arrow or end keys.
+         *
+         * @param enable true to enable the suggestions
+         */
+        void AutoSuggestions(bool enable) { autoSuggestions = enable; }
+
         /**
          * @brief Add an handler that will be called when a @c std::exception (or derived) is thrown inside a command handler.
          * If an exception handler is not set, the exception will be logget on the session output stream.
@@ -200,19 +367,49 @@ namespace cli
 
         void StoreCommands(const std::vector<std::string>& cmds)
         {
-            globalHistoryStorage->Store(cmds);
+            StoreCommands({}, cmds);
+        }
+
+        // With an identity, the storage can keep the commands of each user apart
+        // (the default implementation of HistoryStorage ignores it and calls Store)
+        void StoreCommands(const std::string& identity, const std::vector<std::string>& cmds)
+        {
+            std::lock_guard<std::mutex> lock(*storageMutex);
+            globalHistoryStorage->StoreFor(identity, cmds);
         }
 
         std::vector<std::string> GetCommands() const
         {
-            return globalHistoryStorage->Commands();
+            return GetCommands({});
         }
 
+        std::vector<std::string> GetCommands(const std::string& identity) const
+        {
+            std::lock_guard<std::mutex> lock(*storageMutex);
+            return globalHistoryStorage->CommandsFor(identity);
+        }
+
+        detail::SharedHistory& SharedHistory() { return *sharedHistory; }
+
+        detail::SharedSuggestions& SharedSuggestions() { return *sharedSuggestions; }
+
+        HistoryDuplicates HistoryDuplicatesPolicy() const { return historyDuplicates; }
+
+        bool AutoSuggestions() const { return autoSuggestions; }
+
     private:
         std::unique_ptr<HistoryStorage> globalHistoryStorage;
+        // the sessions can run in different threads (e.g., the shards of a server)
+        std::unique_ptr<std::mutex> storageMutex = std::make_unique<std::mutex>();
+        // live log of the commands issued by the sessions currently running
+        std::unique_ptr<detail::SharedHistory> sharedHistory;
+        // the indexes of the suggestions, shared by the sessions with the same identity
+        std::unique_ptr<detail::SharedSuggestions> sharedSuggestions;
         std::unique_ptr<Menu> rootMenu; // just to keep it alive
         std::function<void(std::ostream&)> exitAction;
         std::function<void(std::ostream&, const std::string& cmd, const std::exception& )> exceptionHandler;
+        HistoryDuplicates historyDuplicates{ HistoryDuplicates::keep };
+        bool autoSuggestions{ false };
     };
 
     // ********************************************************************
@@ -275,11 +472,34 @@ namespace cli
 
     // ********************************************************************
 
+    /**
+     * @brief Produces the output of a command a piece at a time (see @c Paginate).
+     * Each call writes the next piece (e.g., a line) on the stream
+     * and returns false when the output is complete.
+     */
+    using OutputGenerator = std::function<bool(std::ostream&)>;
+
+    // ********************************************************************
+
     class CliSession
     {
     public:
-        CliSession(Cli& _cli, std::ostream& _out, std::size_t historySize = 100);
-        virtual ~CliSession() noexcept { coutPtr->UnRegister(out); }
+        /**
+         * @brief Construct a new session.
+         *
+         * @param _cli the cli object that defines the menu hierarchy for this session
+         * @param _out the output stream where command output will be printed
+         * @param historySize the size of the command history
+         * @param _identity the identity of the session (e.g., the user name), passed to the @c HistoryStorage
+         * to load and store the commands of this session (see @c PartitionedHistoryStorage)
+         */
+        CliSession(Cli& _cli, std::ostream& _out, std::size_t historySize = 100, std::string _identity = {});
+        virtual ~CliSession() noexcept
+        {
+            coutPtr->UnRegister(out);
+            if (out.pword(SessionIndex()) == this)
+                out.pword(SessionIndex()) = nullptr;
+        }
 
         // disable value semantics
         CliSession(const CliSession&) = delete;
@@ -288,7 +508,10 @@ namespace cli
         CliSession(CliSession&&) = delete;
         CliSession& operator = (CliSession&&) = delete;
 
-        void Feed(const std::string& cmd);
+        // The outcome of a command line
+        enum class Result { ok, empty, wrongCommand, exception };
+
+        Result Feed(const std::string& cmd);
 
         void Prompt();
 
@@ -303,8 +526,8 @@ namespace cli
             exitAction(out);
             cli.ExitAction(out);
 
-            auto cmds = history.GetCommands();
-            cli.StoreCommands(cmds);
+            const auto cmds = history ? history->GetCommands() : std::vector<std::string>{};
+            cli.StoreCommands(identity, cmds);
 
             exit = true; // prevent the prompt to be shown
         }
@@ -314,32 +537,154 @@ namespace cli
             exitAction = action;
         }
 
-        void ShowHistory() const { history.Show(out); }
+        void ShowHistory() { LoadedHistory().Show(out); }
 
         std::string PreviousCmd(const std::string& line)
         {
-            return history.Previous(line);
+            auto& h = LoadedHistory();
+            if (!h.Browsing())
+                cli.SharedHistory().Read(sharedCursor, [&h](const std::string& c){ h.Merge(c); });
+            return h.Previous(line);
         }
 
         std::string NextCmd()
         {
-            return history.Next();
+            if (!history) return {};
+            return history->Next();
         }
 
         std::vector<std::string> GetCompletions(std::string currentLine) const;
 
+        const std::string& Identity() const { return identity; }
+
+        bool AutoSuggestions() const { return autoSuggestions; }
+
+        // Returns the most likely command starting with line, or the empty string
+        std::string Suggestion(const std::string& line)
+        {
+            if (!autoSuggestions) return {};
+            LoadedHistory();
+            return suggestions->Suggestion(line);
+        }
+
+        /**
+         * @brief Enable the pager: the output of the commands that use @c Paginate
+         * is shown one screen at a time.
+         *
+         * @param rows the number of rows of a screen (0 disables the pager)
+         */
+        void Pager(std::size_t rows) { pagerRows = rows; }
+
+        // Returns the session using the stream, if any
+        static CliSession* FromStream(std::ostream& o)
+        {
+            return static_cast<CliSession*>(o.pword(SessionIndex()));
+        }
+
+        // Writes the output of generator, one screen at a time if the pager is enabled
+        void Paginate(OutputGenerator generator);
+
+        // true if the pager is waiting for the user
+        bool Paging() const { return static_cast<bool>(pagerGenerator); }
+
+        // Shows the next lines of the output
+        void PagerShow(std::size_t lines);
+
+        // Shows the next page of the output
+        void PagerNextPage() { PagerShow(pagerRows > 1 ? pagerRows - 1 : 1); }
+
+        // Stops the output: the generator is not called anymore
+        void PagerStop() { pagerGenerator = nullptr; }
+
+        // Skips the output until a line containing pattern, then shows the next page
+        void PagerSearch(const std::string& pattern);
+
+    protected:
+
+        // The commands of this session are not recorded in the history, nor shared
+        // with the other sessions (e.g., the commands sent by a program)
+        void DisableHistory() { recordHistory = false; }
+
+        // The output of Cli::cout() will be written on this session in the thread of scheduler
+        void OutputScheduler(Scheduler& scheduler)
+        {
+            coutPtr->UnRegister(out);
+            coutPtr->Register(out, &scheduler);
+        }
+
     private:
 
+        // The history (and the index of the suggestions) is loaded from the HistoryStorage
+        // the first time it's used, so that the sessions that never use it don't keep a copy.
+        detail::History& LoadedHistory();
+
+        // The commands available in every menu (e.g., "help" and "exit"),
+        // shared by all the sessions.
+        static Menu& GlobalScopeMenu();
+
+        void AddSuggestion(const std::string& cmd)
+        {
+            if (suggestions)
+                suggestions->Add(cmd);
+        }
+
+        static int SessionIndex()
+        {
+            static const int index = std::ios_base::xalloc();
+            return index;
+        }
+
+        // Calls the generator of the pager, returning its output.
+        // The generator is dropped at the end of the output (or on exceptions).
+        std::string Generate();
+
         Cli& cli;
+        const std::string identity;
         std::shared_ptr<cli::OutStream> coutPtr;
         Menu* current;
-        std::unique_ptr<Menu> globalScopeMenu;
         std::ostream& out;
         std::function< void(std::ostream&)> exitAction = []( std::ostream& ){};
-        detail::History history;
+        const std::size_t historySize;
+        const HistoryDuplicates historyDuplicates;
+        const bool autoSuggestions;
+        std::unique_ptr<detail::History> history; // null until it's used
+        detail::SharedHistory::Cursor sharedCursor;
+        // shared with the other sessions of the same identity: only if enabled, null until the history is used
+        std::shared_ptr<detail::SharedSuggestions::Index> suggestions;
         bool exit{ false }; // to prevent the prompt after exit command
+        bool recordHistory{ true };
+        std::size_t pagerRows = 0; // 0 if the pager is disabled
+        OutputGenerator pagerGenerator; // the output still to show
+        std::string pagerCommand; // the command that produces the output
+        detail::ColorCache colors;
+        std::string prompt; // the prompt of promptMenu, with the colors
+        const Menu* promptMenu = nullptr;
+        bool promptColor = false;
     };
 
+    /**
+     * @brief Writes on out the output produced by generator.
+     * If out is the stream of a session with the pager enabled (see @c CliSession::Pager)
+     * the output is shown one screen at a time, and the generator is only called
+     * when the user asks for more (so, it's not called anymore after the user quits).
+     * Otherwise, the generator is called until the output is complete.
+     *
+     * Use it in the command handlers, e.g.:
+     * @code
+     * rootMenu->Insert("dump", [](std::ostream& out){
+     *     auto i = std::make_shared<int>(0);
+     *     Paginate(out, [i](std::ostream& o){ o << "line " << (*i)++ << '\n'; return *i < 1000000; });
+     * });
+     * @endcode
+     */
+    inline void Paginate(std::ostream& out, OutputGenerator generator)
+    {
+        if (auto session = CliSession::FromStream(out))
+            session->Paginate(std::move(generator));
+        else
+            while (generator(out)) {}
+    }
+
     // ********************************************************************
 
     class CmdHandler
@@ -712,87 +1057,230 @@ namespace cli
         const std::vector<std::string> parameterDesc;
     };
 
+    // A command without parameters that acts on the session running it (e.g., "exit"),
+    // so that the same command can be shared by all the sessions.
+    class SessionCommand : public Command
+    {
+    public:
+        // disable value semantics
+        SessionCommand(const SessionCommand&) = delete;
+        SessionCommand& operator = (const SessionCommand&) = delete;
+
+        SessionCommand(const std::string& _name, void (*fun)(CliSession&), std::string desc)
+            : Command(_name), func(fun), description(std::move(desc))
+        {
+        }
+
+        bool Exec(const std::vector< std::string >& cmdLine, CliSession& session) override
+        {
+            if (!IsEnabled()) return false;
+            if (cmdLine.size() != 1 || Name() != cmdLine[0]) return false;
+            func(session);
+            return true;
+        }
+
+        void Help(std::ostream& out) const override
+        {
+            if (!IsEnabled()) return;
+            out << " - " << Name() << "\n\t" << description << "\n";
+        }
+
+    private:
+
+        void (* const func)(CliSession&);
+        const std::string description;
+    };
+
 
     // ********************************************************************
 
     // CliSession implementation
 
-    inline CliSession::CliSession(Cli& _cli, std::ostream& _out, std::size_t historySize) :
+    inline CliSession::CliSession(Cli& _cli, std::ostream& _out, std::size_t _historySize, std::string _identity) :
             cli(_cli),
+            identity(std::move(_identity)),
             coutPtr(Cli::CoutPtr()),
             current(cli.RootMenu()),
-            globalScopeMenu(std::make_unique< Menu >()),
             out(_out),
-            history(historySize)
+            historySize(_historySize),
+            historyDuplicates(cli.HistoryDuplicatesPolicy()),
+            autoSuggestions(cli.AutoSuggestions()),
+            sharedCursor(cli.SharedHistory().NewCursor(identity)),
+            colors(out)
         {
-            history.LoadCommands(cli.GetCommands());
-
             coutPtr->Register(out);
-            globalScopeMenu->Insert(
+            out.pword(SessionIndex()) = this;
+        }
+
+    inline detail::History& CliSession::LoadedHistory()
+    {
+        if (!history)
+        {
+            // NB: a command issued after the creation of this session by another one
+            // that has exited in the meantime is found both in the storage and in the
+            // shared history, so it's merged again (see HistoryDuplicates::eraseOlder)
+            history = std::make_unique<detail::History>(historySize, historyDuplicates);
+            const auto cmds = cli.GetCommands(identity);
+            history->LoadCommands(cmds);
+            if (autoSuggestions)
+                suggestions = cli.SharedSuggestions().Get(identity, cmds);
+        }
+        return *history;
+    }
+
+    inline Menu& CliSession::GlobalScopeMenu()
+    {
+        static const std::unique_ptr<Menu> menu = []()
+        {
+            auto m = std::make_unique<Menu>();
+            m->Insert(std::make_unique<SessionCommand>(
                 "help",
-                [this](std::ostream&){ Help(); },
+                [](CliSession& s){ s.Help(); },
                 "This help message"
-            );
-            globalScopeMenu->Insert(
+            ));
+            m->Insert(std::make_unique<SessionCommand>(
                 "exit",
-                [this](std::ostream&){ Exit(); },
+                [](CliSession& s){ s.Exit(); },
                 "Quit the session"
-            );
+            ));
 #ifdef CLI_HISTORY_CMD
-            globalScopeMenu->Insert(
+            m->Insert(std::make_unique<SessionCommand>(
                 "history",
-                [this](std::ostream&){ ShowHistory(); },
+                [](CliSession& s){ s.ShowHistory(); },
                 "Show the history"
-            );
+            ));
 #endif
-        }
+            return m;
+        }();
+        return *menu;
+    }
 
-    inline void CliSession::Feed(const std::string& cmd)
+    inline CliSession::Result CliSession::Feed(const std::string& cmd)
     {
         std::vector<std::string> strs;
         detail::split(strs, cmd);
-        if (strs.empty()) return; // just hit enter
+        if (strs.empty()) return Result::empty; // just hit enter
 
-        history.NewCommand(cmd); // add anyway to history
+        PagerStop(); // a new command discards the rest of the previous output
+        pagerCommand = cmd;
+        if (recordHistory)
+        {
+            LoadedHistory().NewCommand(cmd); // add anyway to history
+            cli.SharedHistory().Append(sharedCursor, cmd); // and let the other sessions see it
+            AddSuggestion(cmd);
+        }
 
         try
         {
 
             // global cmds check
-            bool found = globalScopeMenu->ScanCmds(strs, *this);
+            bool found = GlobalScopeMenu().ScanCmds(strs, *this);
 
             // root menu recursive cmds check
             if (!found) found = current->ScanCmds(strs, *this);
 
             if (!found) // error msg if not found
+            {
                 out << "wrong command: " << cmd << '\n';
+                return Result::wrongCommand;
+            }
         }
         catch(const std::exception& e)
         {
             cli.StdExceptionHandler(out, cmd, e);
+            return Result::exception;
         }
         catch(...)
         {
             out << "Cli. Unknown exception caught handling command line \""
                 << cmd
                 << "\"\n";
+            return Result::exception;
+        }
+        return Result::ok;
+    }
+
+    inline void CliSession::Paginate(OutputGenerator generator)
+    {
+        if (pagerRows == 0)
+        {
+            while (generator(out)) {}
+            return;
+        }
+        pagerGenerator = std::move(generator);
+        PagerNextPage();
+    }
+
+    inline std::string CliSession::Generate()
+    {
+        std::ostringstream piece;
+        try
+        {
+            if (!pagerGenerator(piece))
+                pagerGenerator = nullptr;
+        }
+        catch(const std::exception& e)
+        {
+            pagerGenerator = nullptr;
+            cli.StdExceptionHandler(piece, pagerCommand, e);
         }
+        catch(...)
+        {
+            pagerGenerator = nullptr;
+            piece << "Cli. Unknown exception caught handling command line \""
+                  << pagerCommand
+                  << "\"\n";
+        }
+        return piece.str();
+    }
+
+    inline void CliSession::PagerShow(std::size_t lines)
+    {
+        std::size_t shown = 0;
+        while (Paging() && shown < lines)
+        {
+            const auto piece = Generate();
+            shown += static_cast<std::size_t>(std::count(piece.begin(), piece.end(), '\n'));
+            out << piece;
+        }
+        out << std::flush;
+    }
+
+    inline void CliSession::PagerSearch(const std::string& pattern)
+    {
+        while (Paging())
+        {
+            const auto piece = Generate();
+            if (piece.find(pattern) != std::string::npos)
+            {
+                out << "...skipping\n" << piece;
+                const auto lines = static_cast<std::size_t>(std::count(piece.begin(), piece.end(), '\n'));
+                const auto page = pagerRows > 2 ? pagerRows - 2 : 1; // rows minus "...skipping" and "--More--"
+                if (lines < page)
+                    PagerShow(page - lines);
+                return;
+            }
+        }
+        out << "Pattern not found\n" << std::flush;
     }
 
     inline void CliSession::Prompt()
     {
-        if (exit) return;
-        out << beforePrompt
-            << current->Prompt()
-            << afterPrompt
-            << "> "
-            << std::flush;
+        if (exit || Paging()) return;
+        const auto& c = colors.Get();
+        if (promptMenu != current || promptColor != c.color)
+        {
+            prompt = c.beforePrompt + current->Prompt() + c.afterPrompt + "> ";
+            promptMenu = current;
+            promptColor = c.color;
+        }
+        out << prompt << std::flush;
     }
 
     inline void CliSession::Help() const
     {
         out << "Commands available:\n";
-        globalScopeMenu->MainHelp(out);
+        GlobalScopeMenu().MainHelp(out);
         current -> MainHelp( out );
     }
 
@@ -800,7 +1288,7 @@ namespace cli
     {
         // trim_left(currentLine);
         currentLine.erase(currentLine.begin(), std::find_if(currentLine.begin(), currentLine.end(), [](int ch) { return !std::isspace(ch); }));
-        auto v1 = globalScopeMenu->GetCompletions(currentLine);
+        auto v1 = GlobalScopeMenu().GetCompletions(currentLine);
         auto v3 = current->GetCompletions(currentLine);
         v1.insert(v1.end(), std::make_move_iterator(v3.begin()), std::make_move_iterator(v3.end()));
 
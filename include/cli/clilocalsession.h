@@ -31,6 +31,8 @@
 #define CLI_CLILOCALSESSION_H
 
 #include <ostream> // std::ostream
+#include <string>
+#include <utility> // std::move
 #include "detail/inputhandler.h"
 #include "cli.h" // CliSession
 #include "detail/keyboard.h"
@@ -58,12 +60,14 @@ public:
      * @param scheduler The scheduler that will process the command handlers
      * @param _out the output stream where command output will be printed
      * @param historySize the size of the command history
+     * @param identity the identity of the session, used by the history storage
      */
-    CliLocalTerminalSession(Cli& _cli, Scheduler& scheduler, std::ostream& _out, std::size_t historySize = 100) :
-        CliSession(_cli, _out, historySize),
+    CliLocalTerminalSession(Cli& _cli, Scheduler& scheduler, std::ostream& _out, std::size_t historySize = 100, std::string identity = {}) :
+        CliSession(_cli, _out, historySize, std::move(identity)),
         kb(scheduler),
         ih(*this, kb)
     {
+        OutputScheduler(scheduler);
         Prompt();
     }
 
@@ -30,6 +30,8 @@
 #ifndef CLI_COLORPROFILE_H_
 #define CLI_COLORPROFILE_H_
 
+#include <ostream>
+#include <string>
 #include "detail/rang.h"
 
 namespace cli
@@ -44,6 +46,8 @@ enum BeforePrompt { beforePrompt };
 enum AfterPrompt { afterPrompt };
 enum BeforeInput { beforeInput };
 enum AfterInput { afterInput };
+enum BeforeSuggestion { beforeSuggestion };
+enum AfterSuggestion { afterSuggestion };
 
 inline std::ostream& operator<<(std::ostream& os, BeforePrompt)
 {
@@ -69,6 +73,88 @@ inline std::ostream& operator<<(std::ostream& os, AfterInput)
     return os;
 }
 
+inline std::ostream& operator<<(std::ostream& os, BeforeSuggestion)
+{
+    if ( Color() ) { os << detail::rang::control::forceColor << detail::rang::fgB::black; }
+    return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, AfterSuggestion)
+{
+    os << detail::rang::style::reset;
+    return os;
+}
+
+namespace detail
+{
+
+// The escape sequences of the color profile for a stream
+struct ColorStrings
+{
+    bool color = false; // the value of Color() used to render the strings
+    std::string beforePrompt;
+    std::string afterPrompt;
+    std::string beforeInput;
+    std::string afterInput;
+    std::string beforeSuggestion;
+    std::string afterSuggestion;
+};
+
+// Renders the color profile for a stream once (and again only when Color() changes),
+// to avoid the checks of the terminal done by the manipulators above at every write.
+class ColorCache
+{
+public:
+    explicit ColorCache(std::ostream& _os) : os(_os) {}
+
+    const ColorStrings& Get()
+    {
+        if (!rendered || strings.color != Color())
+            Render();
+        return strings;
+    }
+
+private:
+    void Render()
+    {
+        using namespace rang::rang_implementation;
+        strings = ColorStrings{};
+        strings.color = Color();
+        rendered = true;
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+        // the legacy console sets the colors through the API: no escape sequences to render
+        if (getConsoleHandle() && isTerminal(os.rdbuf()))
+            return;
+#endif
+        if (strings.color)
+        {
+            os << rang::control::forceColor;
+            strings.beforePrompt = Sequence(rang::fg::green) + Sequence(rang::style::bold);
+            strings.beforeInput = Sequence(rang::fgB::gray);
+            strings.beforeSuggestion = Sequence(rang::fgB::black);
+        }
+        // the reset is sent as rang would do: when colors are forced or on a color terminal
+        if (os.iword(getIword()) || (supportsColor() && isTerminal(os.rdbuf())))
+        {
+            strings.afterPrompt = Sequence(rang::style::reset);
+            strings.afterInput = strings.afterPrompt;
+            strings.afterSuggestion = strings.afterPrompt;
+        }
+    }
+
+    template <typename T>
+    static std::string Sequence(T value)
+    {
+        return "\033[" + std::to_string(static_cast<int>(value)) + 'm';
+    }
+
+    std::ostream& os;
+    bool rendered = false;
+    ColorStrings strings;
+};
+
+} // namespace detail
+
 } // namespace cli
 
 #endif // CLI_COLORPROFILE_H_
@@ -0,0 +1,194 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#ifndef CLI_DETAIL_BUFFERPOOL_H_
+#define CLI_DETAIL_BUFFERPOOL_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cli
+{
+namespace detail
+{
+
+// A pool of buffers whose sizes are powers of two, from minSize to maxSize.
+// A buffer goes back to the pool when released, and it's reused by the next request
+// of the same size (the pool keeps at most maxFree buffers of each size), so that
+// the sessions can change the size of their buffers without allocating every time.
+// The buffers keep the pool alive, so the pool must be created with std::make_shared.
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+public:
+
+    // A buffer taken from the pool, that goes back to it when destroyed
+    class Buffer
+    {
+    public:
+        Buffer() = default;
+        Buffer(Buffer&& other) :
+            pool(std::move(other.pool)), memory(std::move(other.memory)), size(other.size)
+        {
+            other.size = 0;
+        }
+        Buffer& operator = (Buffer&& other)
+        {
+            if (this != &other)
+            {
+                Release();
+                pool = std::move(other.pool);
+                memory = std::move(other.memory);
+                size = other.size;
+                other.size = 0;
+            }
+            return *this;
+        }
+        ~Buffer() { Release(); }
+
+        char* Data() const { return memory.get(); }
+        std::size_t Size() const { return size; }
+        explicit operator bool() const { return memory != nullptr; }
+
+    private:
+        friend class BufferPool;
+        Buffer(std::shared_ptr<BufferPool> _pool, std::unique_ptr<char[]> _memory, std::size_t _size) :
+            pool(std::move(_pool)), memory(std::move(_memory)), size(_size) {}
+        void Release()
+        {
+            if (pool && memory)
+                pool->Put(std::move(memory), size);
+            pool.reset();
+            memory.reset();
+            size = 0;
+        }
+        std::shared_ptr<BufferPool> pool;
+        std::unique_ptr<char[]> memory;
+        std::size_t size = 0;
+    };
+
+    struct Stats
+    {
+        std::uint64_t allocated = 0; // buffers allocated from the heap
+        std::uint64_t reused = 0;    // buffers taken from the pool
+        std::size_t free = 0;        // buffers waiting in the pool
+    };
+
+    explicit BufferPool(std::size_t _minSize = 1024, std::size_t _maxSize = 64 * 1024, std::size_t _maxFree = 64) :
+        minSize(RoundUp(std::max<std::size_t>(_minSize, 1))),
+        maxSize(std::max(RoundUp(_maxSize), minSize)),
+        maxFree(_maxFree)
+    {
+        for (auto s = minSize; s <= maxSize; s *= 2)
+            free.emplace_back();
+    }
+
+    // disable value semantics
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator = (const BufferPool&) = delete;
+
+    // The pool shared by the sessions of all the servers
+    static std::shared_ptr<BufferPool> Shared()
+    {
+        static auto pool = std::make_shared<BufferPool>();
+        return pool;
+    }
+
+    // Returns a buffer of (at least) size bytes, between MinSize() and MaxSize()
+    Buffer Get(std::size_t size)
+    {
+        size = std::min(std::max(RoundUp(size), minSize), maxSize);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& list = free[Index(size)];
+            if (!list.empty())
+            {
+                auto memory = std::move(list.back());
+                list.pop_back();
+                ++stats.reused;
+                --stats.free;
+                return Buffer(shared_from_this(), std::move(memory), size);
+            }
+            ++stats.allocated;
+        }
+        return Buffer(shared_from_this(), std::unique_ptr<char[]>(new char[size]), size);
+    }
+
+    std::size_t MinSize() const { return minSize; }
+    std::size_t MaxSize() const { return maxSize; }
+
+    Stats Statistics() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+
+    void Put(std::unique_ptr<char[]> memory, std::size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& list = free[Index(size)];
+        if (list.size() < maxFree)
+        {
+            list.push_back(std::move(memory));
+            ++stats.free;
+        }
+    }
+
+    static std::size_t RoundUp(std::size_t n)
+    {
+        std::size_t result = 1;
+        while (result < n)
+            result *= 2;
+        return result;
+    }
+
+    std::size_t Index(std::size_t size) const
+    {
+        std::size_t i = 0;
+        for (auto s = minSize; s < size; s *= 2)
+            ++i;
+        return i;
+    }
+
+    const std::size_t minSize;
+    const std::size_t maxSize;
+    const std::size_t maxFree;
+    mutable std::mutex mutex;
+    std::vector<std::vector<std::unique_ptr<char[]>>> free; // for each size
+    Stats stats;
+};
+
+} // namespace detail
+} // namespace cli
+
+#endif // CLI_DETAIL_BUFFERPOOL_H_
@@ -0,0 +1,104 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#ifndef CLI_DETAIL_DEFLATER_H_
+#define CLI_DETAIL_DEFLATER_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+
+namespace cli
+{
+namespace detail
+{
+
+// zlib compression of a stream of data
+class Deflater
+{
+public:
+    explicit Deflater(int level)
+    {
+        if (deflateInit(&stream, level) != Z_OK)
+            throw std::runtime_error("Cli. Cannot initialize zlib");
+    }
+    ~Deflater() { deflateEnd(&stream); }
+
+    // disable value semantics
+    Deflater(const Deflater&) = delete;
+    Deflater& operator = (const Deflater&) = delete;
+
+    // Appends to out the compressed data (some of it can remain in the compressor until Flush)
+    void Compress(const char* data, std::size_t size, std::string& out)
+    {
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream.avail_in = static_cast<uInt>(size);
+        Deflate(Z_NO_FLUSH, out);
+        totalIn += size;
+    }
+
+    // Appends to out all the compressed data pending, so that the peer can decompress it
+    void Flush(std::string& out)
+    {
+        stream.next_in = nullptr;
+        stream.avail_in = 0;
+        Deflate(Z_SYNC_FLUSH, out);
+    }
+
+    std::uint64_t In() const { return totalIn; }
+    std::uint64_t Out() const { return totalOut; }
+
+private:
+
+    void Deflate(int flush, std::string& out)
+    {
+        do
+        {
+            const auto oldSize = out.size();
+            const std::size_t chunk = 4096;
+            out.resize(oldSize + chunk);
+            stream.next_out = reinterpret_cast<Bytef*>(&out[oldSize]);
+            stream.avail_out = static_cast<uInt>(chunk);
+            deflate(&stream, flush); // Z_BUF_ERROR is not fatal here
+            const auto produced = chunk - stream.avail_out;
+            out.resize(oldSize + produced);
+            totalOut += produced;
+        } while (stream.avail_in > 0 || stream.avail_out == 0);
+    }
+
+    z_stream stream{};
+    std::uint64_t totalIn = 0;
+    std::uint64_t totalOut = 0;
+};
+
+} // namespace detail
+} // namespace cli
+
+#endif // CLI_DETAIL_DEFLATER_H_
@@ -30,10 +30,17 @@
 #ifndef CLI_DETAIL_GENERICASIOREMOTECLI_H_
 #define CLI_DETAIL_GENERICASIOREMOTECLI_H_
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <sstream>
+#include <vector>
 #include "../cli.h"
 #include "inputhandler.h"
 #include "server.h"
+#include "localserver.h"
 #include "inputdevice.h"
 #include "genericasioscheduler.h"
 
@@ -51,17 +58,53 @@ public:
         Session(std::move(_socket))
     {}
 
+#ifdef CLI_USE_ZLIB
+    // Offer to the client the compression of the output (MCCP2, telnet option 86)
+    // with the zlib level specified (0-9, or -1 for the zlib default).
+    // Must be called before Start.
+    void Compression(int level) { compressionLevel = level; }
+
+    // Returns the ratio between the size of the output and the size of the data sent,
+    // or 0 if the output is not compressed
+    double CompressionRatio()
+    {
+        const auto bytes = CompressionBytes();
+        return bytes.second == 0 ? 0.0 : static_cast<double>(bytes.first) / static_cast<double>(bytes.second);
+    }
+#endif
+
 protected:
 
-    std::string Encode(const std::string& _data) const override
+    // Translates '\n' in "\r\n" and escapes IAC (0xFF) doubling it (RFC 854).
+    // The result is made of slices of _data and static fragments, so nothing is copied.
+    void Encode(const std::string& _data, std::vector<asiolib::const_buffer>& buffers) const override
     {
-        std::string result;
-        for (char c: _data)
+        static const char crlf[] = { '\r', '\n' };
+        static const char iacIac[] = { '\xFF', '\xFF' };
+
+        const char* begin = _data.data();
+        const char* const end = begin + _data.size();
+        const char* nl = Find(begin, end, '\n');
+        const char* iac = Find(begin, end, '\xFF');
+        while (nl != end || iac != end)
         {
-            if (c == '\n') result += '\r';
-            result += c;
+            const char* special = std::min(nl, iac);
+            if (special != begin)
+                buffers.push_back(asiolib::buffer(begin, static_cast<std::size_t>(special - begin)));
+            if (special == nl)
+            {
+                buffers.push_back(asiolib::buffer(crlf));
+                nl = Find(special + 1, end, '\n');
+            }
+            else
+            {
+                buffers.push_back(asiolib::buffer(iacIac));
+                iac = Find(special + 1, end, '\xFF');
+            }
+            begin = special + 1;
         }
-        return result;
+        if (begin != end)
+            buffers.push_back(asiolib::buffer(begin, static_cast<std::size_t>(end - begin)));
     }
 
     void OnConnect() override
@@ -77,14 +120,24 @@ protected:
 
         // https://www.ibm.com/support/knowledgecenter/SSLTBW_1.13.0/com.ibm.zos.r13.hald001/telcmds.htm
 
+        // NB: the telnet commands must not be encoded, so they don't go through OutStream()
+
         static const std::string iacDoLineMode{ "\x0FF\x0FD\x022", 3 };
-        this -> OutStream() << iacDoLineMode << std::flush;
+        SendRaw(iacDoLineMode);
 
         static const std::string iacSbLineMode0IacSe{ "\x0FF\x0FA\x022\x001\x000\x0FF\x0F0", 7 };
-        this -> OutStream() << iacSbLineMode0IacSe << std::flush;
+        SendRaw(iacSbLineMode0IacSe);
 
         static const std::string iacWillEcho{ "\x0FF\x0FB\x001", 3 };
-        this -> OutStream() << iacWillEcho << std::flush;
+        SendRaw(iacWillEcho);
+
+#ifdef CLI_USE_ZLIB
+        if (compressionLevel >= -1)
+        {
+            static const std::string iacWillCompress2{ "\x0FF\x0FB\x056", 3 };
+            SendRaw(iacWillCompress2);
+        }
+#endif
 
 /*
         constexpr char IAC = '\x0FF'; // 255
@@ -214,13 +267,31 @@ protected:
         TERMINAL_TYPE = '\x018',
         NEGOTIATE_ABOUT_WIN_SIZE = '\x01F',
         TERMINAL_SPEED = '\x020',
-        NEW_ENV_OPTION = '\x027'
+        NEW_ENV_OPTION = '\x027',
+        COMPRESS2 = '\x056'
     };
 
-    void OnDataReceived(const std::string& _data) override
+    // The data between the telnet commands goes downstream in runs, found with memchr:
+    // the state machine runs only from an IAC to the end of its command.
+    void OnDataReceived(const ReceivedData& _data) override
     {
-        for (auto c: _data)
-            Consume(c);
+        const char* begin = _data.begin();
+        const char* const end = _data.end();
+        while (begin != end)
+        {
+            if (escape || state != State::data)
+            {
+                Consume(*begin++);
+                continue;
+            }
+            const char* iac = Find(begin, end, '\xFF');
+            if (iac != begin)
+                OutputRun(begin, static_cast<std::size_t>(iac - begin));
+            if (iac == end)
+                break;
+            escape = true;
+            begin = iac + 1;
+        }
     }
 
 private:
@@ -379,6 +450,17 @@ private:
             case SUPPRESS_GO_AHEAD:
                 SendIacCmd(WILL, SUPPRESS_GO_AHEAD);
                 break;
+#ifdef CLI_USE_ZLIB
+            case COMPRESS2:
+                if (compressionLevel >= -1 && !compressing)
+                {
+                    // from now on, the output is a zlib stream
+                    static const std::string iacSbCompress2IacSe{ "\x0FF\x0FA\x056\x0FF\x0F0", 5 };
+                    StartCompression(iacSbCompress2IacSe, compressionLevel);
+                    compressing = true;
+                }
+                break;
+#endif
             default:
                 SendIacCmd(WONT, c);
         };
@@ -404,7 +486,7 @@ private:
         std::string answer("\x0FF\x000\x000", 3);
         answer[1] = action;
         answer[2] = op;
-        this -> OutStream() << answer << std::flush;
+        SendRaw(answer);
     }
 protected:
     virtual void Output(signed char c)
@@ -415,6 +497,13 @@ protected:
         (void)c;
         #endif
     }
+    // Receives a run of data without telnet commands.
+    // By default, it's passed to Output one character at a time.
+    virtual void OutputRun(const char* data, std::size_t size)
+    {
+        for (std::size_t i = 0; i < size; ++i)
+            Output(data[i]);
+    }
 private:
     enum class State { data, sub, wait_will, wait_wont, wait_do, wait_dont };
     State state = State::data;
@@ -423,12 +512,21 @@ private:
 #endif
 
 private:
+    static const char* Find(const char* begin, const char* end, char c)
+    {
+        const void* p = std::memchr(begin, c, static_cast<std::size_t>(end - begin));
+        return p ? static_cast<const char*>(p) : end;
+    }
     void Feed(char c)
     {
         if (std::isprint(c)) std::cout << c << std::endl;
         else std::cout << "0x" << std::hex << static_cast<int>(c) << std::dec << std::endl;
     }
     std::string buffer;
+#ifdef CLI_USE_ZLIB
+    int compressionLevel = -2; // < -1 if the compression is disabled
+    bool compressing = false;
+#endif
 };
 
 template <typename ASIOLIB>
@@ -450,10 +548,10 @@ class CliTelnetSession : public InputDevice, public TelnetSession, public CliSes
 {
 public:
 
-    CliTelnetSession(Scheduler& _scheduler, asiolib::ip::tcp::socket _socket, Cli& _cli, const std::function< void(std::ostream&)>& _exitAction, std::size_t historySize ) :
+    CliTelnetSession(Scheduler& _scheduler, asiolib::ip::tcp::socket _socket, Cli& _cli, const std::function< void(std::ostream&)>& _exitAction, std::size_t historySize, std::string identity = {} ) :
         InputDevice(_scheduler),
         TelnetSession(std::move(_socket)),
-        CliSession(_cli, TelnetSession::OutStream(), historySize),
+        CliSession(_cli, TelnetSession::OutStream(), historySize, std::move(identity)),
         poll(*this, *this)
     {
         ExitAction([this, _exitAction](std::ostream& _out){ _exitAction(_out), Disconnect(); } );
@@ -463,7 +561,70 @@ protected:
     void OnConnect() override
     {
         TelnetSession::OnConnect();
-        Prompt();
+        auto self( shared_from_this() );
+        PostOutput([this, self](){ Prompt(); });
+    }
+
+    // the keys notified to the scheduler refer to this session,
+    // that must stay alive until the scheduler has handled them
+    void OnDisconnect() override
+    {
+        auto self( shared_from_this() );
+        PostOutput([self](){});
+    }
+    void OnError() override
+    {
+        OnDisconnect();
+    }
+
+    // The keys of the data received are notified together, with a single task
+    void OnDataReceived(const ReceivedData& _data) override
+    {
+        TelnetSession::OnDataReceived(_data);
+        NotifyKeys(std::move(keys));
+        keys.clear();
+    }
+
+    // The printable characters go straight to the input handler:
+    // only the control characters run the state machine of the escape sequences.
+    // The complete lines (printable characters followed by CR NUL or CR LF)
+    // are notified together, in a single task (e.g., the commands pipelined by a script).
+    void OutputRun(const char* data, std::size_t size) override
+    {
+        const char* const end = data + size;
+        std::vector<std::string> lines;
+        while (data != end)
+        {
+            if (step != Step::_1)
+            {
+                Output(*data++);
+                continue;
+            }
+            const char* control = FindControl(data, end);
+            if (end - control >= 2 && control[0] == '\r' && (control[1] == '\0' || control[1] == '\n'))
+            {
+                lines.emplace_back(data, control);
+                data = control + 2;
+                continue;
+            }
+            if (!lines.empty())
+            {
+                NotifyKeys(std::move(keys));
+                keys.clear();
+                NotifyLines(std::move(lines));
+                lines.clear();
+            }
+            for (; data != control; ++data)
+                keys.emplace_back(KeyType::ascii, *data);
+            if (control != end)
+                Output(*data++);
+        }
+        if (!lines.empty())
+        {
+            NotifyKeys(std::move(keys));
+            keys.clear();
+            NotifyLines(std::move(lines));
+        }
     }
 
     void Output(signed char c) override // NB: C++ does not specify wether char is signed or unsigned
@@ -475,17 +636,17 @@ protected:
                 {
                     case EOF:
                     case 4:  // EOT
-                        Notify(std::make_pair(KeyType::eof,' ')); break;
+                        Queue(std::make_pair(KeyType::eof,' ')); break;
                     case 8: // Backspace
                     case 127:  // Backspace or Delete
-                        Notify(std::make_pair(KeyType::backspace, ' ')); break;
-                    //case 10: Notify(std::make_pair(KeyType::ret,' ')); break;
+                        Queue(std::make_pair(KeyType::backspace, ' ')); break;
+                    //case 10: Queue(std::make_pair(KeyType::ret,' ')); break;
                     case 27: step = Step::_2; break;  // symbol
                     case 13: step = Step::wait_0; break;  // wait for 0 (ENTER key)
                     default: // ascii
                     {
                         const char ch = static_cast<char>(c);
-                        Notify(std::make_pair(KeyType::ascii,ch));
+                        Queue(std::make_pair(KeyType::ascii,ch));
                     }
                 }
                 break;
@@ -499,7 +660,7 @@ protected:
                 else
                 {
                     step = Step::_1;
-                    Notify(std::make_pair(KeyType::ignored,' '));
+                    Queue(std::make_pair(KeyType::ignored,' '));
                     break; // unknown
                 }
                 break;
@@ -507,27 +668,27 @@ protected:
             case Step::_3: // got 27 and 91
                 switch( c )
                 {
-                    case 65: step = Step::_1; Notify(std::make_pair(KeyType::up,' ')); break;
-                    case 66: step = Step::_1; Notify(std::make_pair(KeyType::down,' ')); break;
-                    case 68: step = Step::_1; Notify(std::make_pair(KeyType::left,' ')); break;
-                    case 67: step = Step::_1; Notify(std::make_pair(KeyType::right,' ')); break;
-                    case 70: step = Step::_1; Notify(std::make_pair(KeyType::end,' ')); break;
-                    case 72: step = Step::_1; Notify(std::make_pair(KeyType::home,' ')); break;
+                    case 65: step = Step::_1; Queue(std::make_pair(KeyType::up,' ')); break;
+                    case 66: step = Step::_1; Queue(std::make_pair(KeyType::down,' ')); break;
+                    case 68: step = Step::_1; Queue(std::make_pair(KeyType::left,' ')); break;
+                    case 67: step = Step::_1; Queue(std::make_pair(KeyType::right,' ')); break;
+                    case 70: step = Step::_1; Queue(std::make_pair(KeyType::end,' ')); break;
+                    case 72: step = Step::_1; Queue(std::make_pair(KeyType::home,' ')); break;
                     default: step = Step::_4; break;  // not arrow keys
                 }
                 break;
 
             case Step::_4:
-                if ( c == 126 ) Notify(std::make_pair(KeyType::canc,' '));
-                else Notify(std::make_pair(KeyType::ignored,' '));
+                if ( c == 126 ) Queue(std::make_pair(KeyType::canc,' '));
+                else Queue(std::make_pair(KeyType::ignored,' '));
 
                 step = Step::_1;
 
                 break;
 
             case Step::wait_0:
-                if ( c == 0 /* linux */ || c == 10 /* win */ ) Notify(std::make_pair(KeyType::ret,' '));
-                else Notify(std::make_pair(KeyType::ignored,' '));
+                if ( c == 0 /* linux */ || c == 10 /* win */ ) Queue(std::make_pair(KeyType::ret,' '));
+                else Queue(std::make_pair(KeyType::ignored,' '));
 
                 step = Step::_1;
 
@@ -538,8 +699,40 @@ protected:
 
 private:
 
+    // Returns the first control character (below 32, or DEL) in [begin, end), or end.
+    // The bytes are checked eight at a time.
+    static const char* FindControl(const char* begin, const char* end)
+    {
+        const std::uint64_t ones = 0x0101010101010101ULL;
+        const std::uint64_t highs = 0x8080808080808080ULL;
+        while (end - begin >= 8)
+        {
+            std::uint64_t x;
+            std::memcpy(&x, begin, sizeof(x));
+            const std::uint64_t y = x ^ (ones * 127);
+            // the high bit of a byte is set if the byte is < 32 (x), or if it's 127 (y)
+            if ((((x - ones * 32) & ~x) | ((y - ones) & ~y)) & highs)
+                break;
+            begin += 8;
+        }
+        for (; begin != end; ++begin)
+        {
+            const auto c = static_cast<unsigned char>(*begin);
+            if (c < 32 || c == 127)
+                return begin;
+        }
+        return end;
+    }
+
+    // adds a key to the ones to notify at the end of the data received
+    void Queue(std::pair<KeyType,char> k)
+    {
+        keys.push_back(k);
+    }
+
     enum class Step { _1, _2, _3, _4, wait_0 };
     Step step = Step::_1;
+    std::vector<std::pair<KeyType,char>> keys; // waiting to be notified (I/O thread)
     InputHandler poll;
 };
 
@@ -547,14 +740,18 @@ template <typename ASIOLIB>
 class CliGenericTelnetServer : public Server<ASIOLIB>
 {
 public:
-    CliGenericTelnetServer(Cli& _cli, GenericAsioScheduler<ASIOLIB>& _scheduler, unsigned short port, std::size_t _historySize=100 ) :
-        Server<ASIOLIB>(_scheduler.AsioContext(), port),
+    // If shards is not 0, the I/O of the sessions is distributed among shards threads
+    // (see Server). With ShardMode::io the commands are still executed by the scheduler,
+    // while with ShardMode::sessions they are executed by the shard of the session:
+    // they can run at the same time, so their handlers must be thread safe.
+    CliGenericTelnetServer(Cli& _cli, GenericAsioScheduler<ASIOLIB>& _scheduler, unsigned short port, std::size_t _historySize=100, std::size_t shards=0, ShardMode mode=ShardMode::io ) :
+        Server<ASIOLIB>(_scheduler.AsioContext(), port, shards, mode),
         scheduler(_scheduler),
         cli(_cli),
         historySize(_historySize)
     {}
-    CliGenericTelnetServer(Cli& _cli, GenericAsioScheduler<ASIOLIB>& _scheduler, std::string address, unsigned short port, std::size_t _historySize=100 ) :
-        Server<ASIOLIB>(_scheduler.AsioContext(), address, port),
+    CliGenericTelnetServer(Cli& _cli, GenericAsioScheduler<ASIOLIB>& _scheduler, std::string address, unsigned short port, std::size_t _historySize=100, std::size_t shards=0, ShardMode mode=ShardMode::io ) :
+        Server<ASIOLIB>(_scheduler.AsioContext(), address, port, shards, mode),
         scheduler(_scheduler),
         cli(_cli),
         historySize(_historySize)
@@ -563,17 +760,315 @@ public:
     {
         exitAction = action;
     }
+    // Set the function that gives the identity of a new session (see CliSession)
+    // from the address of the remote peer.
+    // By default, the sessions have no identity.
+    void SessionIdentity( std::function< std::string(const asiolib::ip::tcp::endpoint&)> f )
+    {
+        identity = f;
+    }
+    // Set the limits of the output queue of the new sessions (see Session::SendQueue)
+    void SendQueue(std::size_t highWatermark, std::size_t lowWatermark, SendOverflowPolicy policy)
+    {
+        sendHighWatermark = highWatermark;
+        sendLowWatermark = lowWatermark;
+        sendPolicy = policy;
+    }
+    // Set the limits for the output of Cli::cout() to the new sessions (see Session::BroadcastLimit)
+    void BroadcastLimit(std::size_t maxQueued, double linesPerSecond)
+    {
+        broadcastMaxQueued = maxQueued;
+        broadcastRate = linesPerSecond;
+    }
+#ifdef CLI_USE_ZLIB
+    // Offer the MCCP2 compression to the clients, with the zlib level specified
+    // (0-9, or -1 for the zlib default)
+    void Compression(int level)
+    {
+        compressionLevel = level;
+    }
+#endif
+    // Enable the pager in the new sessions (see CliSession::Pager)
+    void Pager(std::size_t rows)
+    {
+        pagerRows = rows;
+    }
+    // Returns the counters of the output of Cli::cout() of all the sessions
+    BroadcastStats Broadcasts() const
+    {
+        BroadcastStats result;
+        result.sent = broadcastTotals->sent;
+        result.dropped = broadcastTotals->dropped;
+        return result;
+    }
     std::shared_ptr<Session> CreateSession(asiolib::ip::tcp::socket _socket) override
     {
-        return std::make_shared<CliTelnetSession>(scheduler, std::move(_socket), cli, exitAction, historySize);
+        return CreateSession(std::move(_socket), scheduler);
+    }
+    std::shared_ptr<Session> CreateSession(asiolib::ip::tcp::socket _socket, Scheduler& _scheduler) override
+    {
+        std::string id;
+        if (identity)
+        {
+            asiolibec::error_code ec;
+            const auto remote = _socket.remote_endpoint(ec);
+            if (!ec)
+                id = identity(remote);
+        }
+        auto session = std::make_shared<CliTelnetSession>(_scheduler, std::move(_socket), cli, exitAction, historySize, std::move(id));
+        session->SendQueue(sendHighWatermark, sendLowWatermark, sendPolicy);
+        session->BroadcastLimit(broadcastMaxQueued, broadcastRate, broadcastTotals);
+        session->Pager(pagerRows);
+#ifdef CLI_USE_ZLIB
+        session->Compression(compressionLevel);
+#endif
+        return session;
     }
 private:
     Scheduler& scheduler;
     Cli& cli;
     std::function< void(std::ostream&)> exitAction;
+    std::function< std::string(const asiolib::ip::tcp::endpoint&)> identity;
+    std::size_t historySize;
+    std::size_t sendHighWatermark = 1024 * 1024;
+    std::size_t sendLowWatermark = 256 * 1024;
+    SendOverflowPolicy sendPolicy = SendOverflowPolicy::block;
+    std::size_t broadcastMaxQueued = 1000;
+    double broadcastRate = 0;
+    std::shared_ptr<BroadcastCounters> broadcastTotals = std::make_shared<BroadcastCounters>();
+    std::size_t pagerRows = 0;
+#ifdef CLI_USE_ZLIB
+    int compressionLevel = -2; // disabled
+#endif
+};
+
+//////////////
+
+// the stream where a machine session collects the output of a command
+// (a base class, so that it's built before CliSession)
+struct MachineOutput
+{
+    std::ostringstream output;
+};
+
+// A session of the machine protocol, for the programs that drive the cli.
+// The client sends command lines tagged with an id (a word chosen by the client),
+// without waiting for the responses, that come in the same order:
+//     request:  <id> <command line>\n
+//     response: <id> <status> <microseconds> <length>\n<output of the command (length bytes)>
+// where status is ok, wrong-command, error (the command threw an exception)
+// or bad-request (a line without id, or longer than maxLine: the session is closed).
+// The empty lines are ignored, and a '\r' before the '\n' is not part of the command.
+// The commands run in the scheduler on the same menus of the telnet sessions,
+// with no terminal, prompt or echo. The output of Cli::cout() is not sent to these sessions,
+// and their commands are not recorded in the history nor in the suggestions.
+class CliMachineSession : private MachineOutput, public Session, public CliSession
+{
+public:
+
+    CliMachineSession(Scheduler& _scheduler, asiolib::generic::stream_protocol::socket _socket, Cli& _cli, std::size_t historySize, std::string identity = {}) :
+        Session(std::move(_socket)),
+        CliSession(_cli, output, historySize, std::move(identity)),
+        scheduler(_scheduler)
+    {
+        Cli::cout().UnRegister(output);
+        DisableHistory();
+        ExitAction([this](std::ostream&){ exiting = true; });
+    }
+
+protected:
+
+    void OnConnect() override {}
+
+    // the tasks posted to the scheduler refer to this session,
+    // that must stay alive until the scheduler has run them
+    void OnDisconnect() override
+    {
+        auto self( shared_from_this() );
+        scheduler.Post([self](){});
+    }
+    void OnError() override
+    {
+        OnDisconnect();
+    }
+
+    // The complete lines of each read are executed by a single task of the scheduler
+    void OnDataReceived(const ReceivedData& _data) override
+    {
+        if (overflow)
+            return;
+        std::vector<std::string> lines;
+        const char* begin = _data.begin();
+        const char* const end = _data.end();
+        while (begin != end)
+        {
+            const void* nl = std::memchr(begin, '\n', static_cast<std::size_t>(end - begin));
+            const char* lineEnd = nl ? static_cast<const char*>(nl) : end;
+            partial.append(begin, lineEnd);
+            if (partial.size() > maxLine)
+            {
+                overflow = true;
+                std::string().swap(partial);
+                lines.emplace_back();
+                break;
+            }
+            if (!nl)
+                break;
+            lines.push_back(std::move(partial));
+            partial.clear();
+            begin = lineEnd + 1;
+        }
+        if (lines.empty())
+            return;
+        auto self( shared_from_this() );
+        scheduler.Post([this, self, lines = std::move(lines), tooLong = overflow](){ Execute(lines, tooLong); });
+    }
+
+private:
+
+    // Runs the commands, and sends the responses with a single write.
+    // The last line is too long if tooLong is true.
+    void Execute(const std::vector<std::string>& lines, bool tooLong)
+    {
+        auto& out = Session::OutStream();
+        for (std::size_t i = 0; i < lines.size() && !exiting; ++i)
+        {
+            if (tooLong && i == lines.size() - 1)
+            {
+                out << "- bad-request 0 0\n";
+                exiting = true;
+                break;
+            }
+            std::string line = lines[i];
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.find_first_not_of(" \t") == std::string::npos)
+                continue;
+            const auto space = line.find(' ');
+            if (space == 0)
+            {
+                out << "- bad-request 0 0\n";
+                exiting = true;
+                break;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            const auto result = Feed(space == std::string::npos ? std::string() : line.substr(space + 1));
+            const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            const std::string text = output.str();
+            output.str(std::string());
+            out << line.substr(0, space) << ' ' << Status(result) << ' ' << elapsed.count() << ' ' << text.size() << '\n' << text;
+        }
+        out << std::flush;
+        if (exiting)
+            Disconnect();
+    }
+
+    static const char* Status(Result result)
+    {
+        switch (result)
+        {
+            case Result::ok:
+            case Result::empty:
+                return "ok";
+            case Result::wrongCommand:
+                return "wrong-command";
+            case Result::exception:
+                return "error";
+        }
+        return "error";
+    }
+
+    enum { maxLine = 64 * 1024 };
+    Scheduler& scheduler;
+    std::string partial; // the line being received
+    bool overflow = false; // a line was too long (I/O thread)
+    bool exiting = false; // the session is closing (scheduler thread)
+};
+
+template <typename ASIOLIB>
+class CliGenericMachineServer : public Server<ASIOLIB>
+{
+public:
+    // If shards is not 0, the I/O of the sessions is distributed among shards threads
+    // (see Server). With ShardMode::io the commands are still executed by the scheduler,
+    // while with ShardMode::sessions they are executed by the shard of the session:
+    // they can run at the same time, so their handlers must be thread safe.
+    CliGenericMachineServer(Cli& _cli, GenericAsioScheduler<ASIOLIB>& _scheduler, unsigned short port, std::size_t _historySize=100, std::size_t shards=0, ShardMode mode=ShardMode::io ) :
+        Server<ASIOLIB>(_scheduler.AsioContext(), port, shards, mode),
+        scheduler(_scheduler),
+        cli(_cli),
+        historySize(_historySize)
+    {}
+    CliGenericMachineServer(Cli& _cli, GenericAsioScheduler<ASIOLIB>& _scheduler, std::string address, unsigned short port, std::size_t _historySize=100, std::size_t shards=0, ShardMode mode=ShardMode::io ) :
+        Server<ASIOLIB>(_scheduler.AsioContext(), address, port, shards, mode),
+        scheduler(_scheduler),
+        cli(_cli),
+        historySize(_historySize)
+    {}
+    // Set the function that gives the identity of a new session (see CliSession)
+    // from the address of the remote peer.
+    // By default, the sessions have no identity.
+    void SessionIdentity( std::function< std::string(const asiolib::ip::tcp::endpoint&)> f )
+    {
+        identity = f;
+    }
+    std::shared_ptr<Session> CreateSession(asiolib::ip::tcp::socket _socket) override
+    {
+        return CreateSession(std::move(_socket), scheduler);
+    }
+    std::shared_ptr<Session> CreateSession(asiolib::ip::tcp::socket _socket, Scheduler& _scheduler) override
+    {
+        std::string id;
+        if (identity)
+        {
+            asiolibec::error_code ec;
+            const auto remote = _socket.remote_endpoint(ec);
+            if (!ec)
+                id = identity(remote);
+        }
+        return std::make_shared<CliMachineSession>(_scheduler, std::move(_socket), cli, historySize, std::move(id));
+    }
+private:
+    Scheduler& scheduler;
+    Cli& cli;
+    std::function< std::string(const asiolib::ip::tcp::endpoint&)> identity;
+    std::size_t historySize;
+};
+
+#ifdef CLI_DETAIL_LOCAL_SOCKETS
+
+// A server of the machine protocol (see CliMachineSession) on a unix domain socket,
+// for the programs running on the same host.
+template <typename ASIOLIB>
+class CliGenericLocalServer : public LocalServer<ASIOLIB>
+{
+public:
+    // Create the socket at path with the permissions specified (see LocalServer)
+    CliGenericLocalServer(Cli& _cli, GenericAsioScheduler<ASIOLIB>& _scheduler, std::string path, unsigned permissions = 0600, std::size_t _historySize=100 ) :
+        LocalServer<ASIOLIB>(_scheduler.AsioContext(), std::move(path), permissions),
+        scheduler(_scheduler),
+        cli(_cli),
+        historySize(_historySize)
+    {}
+    // Set the function that gives the identity of a new session (see CliSession)
+    // from the credentials of the peer process (e.g., its user).
+    // By default, the sessions have no identity.
+    void SessionIdentity( std::function< std::string(const PeerCredentials&)> f )
+    {
+        identity = f;
+    }
+    std::shared_ptr<Session> CreateSession(asiolib::generic::stream_protocol::socket _socket, const PeerCredentials& peer) override
+    {
+        return std::make_shared<CliMachineSession>(scheduler, std::move(_socket), cli, historySize, identity ? identity(peer) : std::string{});
+    }
+private:
+    Scheduler& scheduler;
+    Cli& cli;
+    std::function< std::string(const PeerCredentials&)> identity;
     std::size_t historySize;
 };
 
+#endif // CLI_DETAIL_LOCAL_SOCKETS
 
 } // namespace detail
 } // namespace cli
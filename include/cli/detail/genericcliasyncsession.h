@@ -47,6 +47,7 @@ public:
         CliSession(_cli, std::cout, 1),
         input(_scheduler.AsioContext(), ::dup(STDIN_FILENO))
     {
+        OutputScheduler(_scheduler);
         Read();
     }
     ~GenericCliAsyncSession() noexcept override
@@ -31,11 +31,12 @@
 #define CLI_DETAIL_HISTORY_H_
 
 #include <deque>
-#include <limits>
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <cassert>
+#include <iterator>
+#include "../historystorage.h" // HistoryDuplicates
 
 namespace cli
 {
@@ -46,32 +47,59 @@ class History
 {
 public:
 
-    explicit History(std::size_t size) : maxSize(size) {}
+    explicit History(std::size_t size, HistoryDuplicates _duplicates = HistoryDuplicates::keep) :
+        maxSize(size),
+        duplicates(_duplicates)
+    {}
 
     // Insert a new item in the buffer, changing the current state to "inserting"
     // If we're browsing the history (eg with arrow keys) the new item overwrites
     // the current one.
     // Otherwise, the item is added to the front of the container
+    // With HistoryDuplicates::eraseOlder, the older occurrences of the item
+    // are removed from the buffer.
     void NewCommand(const std::string& item)
     {
-        ++commands;
         current = 0;
         if (mode == Mode::browsing)
         {
             assert(!buffer.empty());
-            if (buffer.size() > 1 && buffer[1] == item) // try to insert an element identical to last one
+            if (buffer.size() > 1 && buffer[1].command == item) // try to insert an element identical to last one
                 buffer.pop_front();
             else // the item was not identical
-                buffer[current] = item;
+                buffer[current].command = item;
         }
         else // Mode::inserting
         {
-            if (buffer.empty() || buffer[0] != item) // insert an element not equal to last one
+            if (buffer.empty() || buffer[0].command != item) // insert an element not equal to last one
                 Insert(item);
         }
+        if (!buffer.empty())
+            buffer[0].issued = true;
+        EraseOlderDuplicates();
         mode = Mode::inserting;
     }
 
+    // Insert a command issued by another session.
+    // The command can be browsed, but it's not returned by GetCommands
+    // because storing it is up to the session that issued it.
+    // The commands merged never evict the ones issued in this session
+    // (when the buffer is full of them, the command is not merged).
+    // It can only be called when we're not browsing the history.
+    void Merge(const std::string& item)
+    {
+        assert(mode == Mode::inserting);
+        if (buffer.size() >= maxSize &&
+            std::none_of(buffer.begin(), buffer.end(), [](const Item& i){ return !i.issued; }))
+            return;
+        if (buffer.empty() || buffer[0].command != item)
+            Insert(item);
+        EraseOlderDuplicates();
+    }
+
+    // Return true if we're browsing the history (eg with arrow keys)
+    bool Browsing() const { return mode == Mode::browsing; }
+
     // Return the previous item of the history, updating the current item and
     // changing the current state to "browsing"
     // If we're already browsing the history (eg with arrow keys) the edit line is inserted
@@ -88,13 +116,13 @@ public:
         else // Mode::browsing
         {
             assert(!buffer.empty());
-            buffer[current] = line;
+            buffer[current].command = line;
             if (current != buffer.size()-1)
                 ++current;
         }
         assert(mode == Mode::browsing);
         assert(current < buffer.size());
-        return buffer[current];
+        return buffer[current].command;
     }
 
     // Return the next item of the history, updating the current item.
@@ -105,7 +133,7 @@ public:
         assert(current != 0);
         --current;
         assert(current < buffer.size());
-        return buffer[current];
+        return buffer[current].command;
     }
 
     // Show the whole history on the given ostream
@@ -113,7 +141,7 @@ public:
     {
         out << '\n';
         for (auto& item: buffer)
-            out << item << '\n';
+            out << item.command << '\n';
         out << '\n' << std::flush;
     }
 
@@ -125,36 +153,77 @@ public:
     }
 
     // result[0] is the oldest command, result[size-1] the newer
+    // Only the commands issued in this session are returned.
     std::vector<std::string> GetCommands() const
     {
-        auto numCmdsToReturn = std::min(commands, buffer.size());
         auto start = buffer.begin();
         if (mode == Mode::browsing)
-        {
-            numCmdsToReturn = std::min(commands, buffer.size()-1);
             start = buffer.begin()+1;
-        }
-        std::vector<std::string> result(numCmdsToReturn);
-        assert(std::distance(start, buffer.end()) >= 0);
-        assert(numCmdsToReturn <= static_cast<std::size_t>(std::distance(buffer.end(), start)));
-        assert(numCmdsToReturn <= static_cast<unsigned long>(std::numeric_limits<long>::max()));
-        std::reverse_copy(start, start+static_cast<long>(numCmdsToReturn), result.begin());
+        std::vector<std::string> result;
+        std::for_each(
+            std::make_reverse_iterator(buffer.end()),
+            std::make_reverse_iterator(start),
+            [&result](const Item& item){ if (item.issued) result.push_back(item.command); }
+        );
         return result;
     }
 
 private:
 
+    struct Item
+    {
+        std::string command;
+        bool issued; // true if the command was issued in this session
+    };
+
+    // When the buffer is full, the oldest item not issued in this session is evicted
+    // (but the new one), so that the commands merged don't take the place of the
+    // commands to store at the end of the session.
     void Insert(const std::string& item)
     {
-        buffer.push_front(item);
-        if (buffer.size() > maxSize)
+        buffer.push_front(Item{item, false});
+        if (buffer.size() <= maxSize)
+            return;
+        const auto oldest = std::find_if(
+            buffer.rbegin(),
+            std::prev(buffer.rend()),
+            [](const Item& i){ return !i.issued; }
+        );
+        if (oldest == std::prev(buffer.rend()))
             buffer.pop_back();
+        else
+            buffer.erase(std::next(oldest).base());
+    }
+
+    // The buffer is small and its items can be edited while browsing,
+    // so a linear pass is preferred to keeping an index up to date.
+    void EraseOlderDuplicates()
+    {
+        if (duplicates != HistoryDuplicates::eraseOlder || buffer.empty())
+            return;
+        // the newest occurrence is issued in this session if any of them is
+        // (e.g., a command merged again), so that it's still stored
+        auto& newest = buffer[0];
+        buffer.erase(
+            std::remove_if(
+                std::next(buffer.begin()),
+                buffer.end(),
+                [&newest](const Item& i)
+                {
+                    if (i.command != newest.command)
+                        return false;
+                    newest.issued = newest.issued || i.issued;
+                    return true;
+                }
+            ),
+            buffer.end()
+        );
     }
 
     const std::size_t maxSize;
-    std::deque<std::string> buffer;
+    const HistoryDuplicates duplicates;
+    std::deque<Item> buffer;
     std::size_t current = 0;
-    std::size_t commands = 0; // number of commands issued
     enum class Mode { inserting, browsing };
     Mode mode = Mode::inserting;
 };
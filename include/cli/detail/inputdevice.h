@@ -32,6 +32,7 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 #include "../scheduler.h"
 
 namespace cli
@@ -45,6 +46,8 @@ class InputDevice
 {
 public:
     using Handler = std::function< void( std::pair<KeyType,char> ) >;
+    using KeysHandler = std::function< void( const std::vector<std::pair<KeyType,char>>& ) >;
+    using LinesHandler = std::function< void( const std::vector<std::string>& ) >;
 
     explicit InputDevice(Scheduler& _scheduler) : scheduler(_scheduler) {}
     virtual ~InputDevice() = default;
@@ -52,6 +55,17 @@ public:
     template <typename H>
     void Register(H&& h) { handler = std::forward<H>(h); }
 
+    // Register the handler of the keys notified at once (see NotifyKeys)
+    template <typename H>
+    void RegisterKeys(H&& h) { keysHandler = std::forward<H>(h); }
+
+    // Register the handler of the complete lines notified at once (see NotifyLines)
+    template <typename H>
+    void RegisterLines(H&& h) { linesHandler = std::forward<H>(h); }
+
+    // Returns true if the terminal of the device understands the ANSI escape sequences
+    virtual bool Ansi() const { return true; }
+
 protected:
 
     void Notify(std::pair<KeyType,char> k)
@@ -59,10 +73,52 @@ protected:
         scheduler.Post([this,k](){ if (handler) handler(k); });
     }
 
+    // Notify many keys (e.g., the characters of a paste) with a single task:
+    // without a handler of keys, they are passed to the handler one by one.
+    void NotifyKeys(std::vector<std::pair<KeyType,char>> keys)
+    {
+        if (keys.empty())
+            return;
+        scheduler.Post([this, keys = std::move(keys)](){ Deliver(keys); });
+    }
+
+    // Notify complete lines (each one made of printable characters, followed by return)
+    // with a single task: without a handler of lines, they are notified as their keys.
+    void NotifyLines(std::vector<std::string> lines)
+    {
+        scheduler.Post([this, lines = std::move(lines)]()
+        {
+            if (linesHandler)
+            {
+                linesHandler(lines);
+                return;
+            }
+            std::vector<std::pair<KeyType,char>> keys;
+            for (const auto& line: lines)
+            {
+                for (char c: line)
+                    keys.emplace_back(KeyType::ascii, c);
+                keys.emplace_back(KeyType::ret, ' ');
+            }
+            Deliver(keys);
+        });
+    }
+
 private:
 
+    void Deliver(const std::vector<std::pair<KeyType,char>>& keys)
+    {
+        if (keysHandler)
+            keysHandler(keys);
+        else if (handler)
+            for (const auto& k: keys)
+                handler(k);
+    }
+
     Scheduler& scheduler;
     Handler handler;
+    KeysHandler keysHandler;
+    LinesHandler linesHandler;
 };
 
 } // namespace detail
@@ -32,6 +32,7 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 #include "terminal.h"
 #include "inputdevice.h"
 #include "../cli.h" // CliSession
@@ -47,17 +48,66 @@ class InputHandler
 public:
     InputHandler(CliSession& _session, InputDevice& kb) :
         session(_session),
-        terminal(session.OutStream())
+        terminal(session.OutStream(), kb.Ansi())
     {
         kb.Register( [this](auto key){ this->Keypressed(key); } );
+        kb.RegisterKeys( [this](const auto& keys){ this->KeysPressed(keys); } );
+        kb.RegisterLines( [this](const auto& lines){ this->LinesEntered(lines); } );
     }
 
 private:
 
     void Keypressed(std::pair<KeyType, char> k)
     {
-        const std::pair<Symbol,std::string> s = terminal.Keypressed(k);
-        NewCommand(s);
+        Key(k);
+        // the terminal does not flush: all the output of a key is sent at once
+        session.OutStream() << std::flush;
+    }
+
+    // The keys received at once (e.g., a paste) are handled in one go, with a single flush.
+    // The suggestion is shown only after the last one, unless the next key can accept it.
+    void KeysPressed(const std::vector<std::pair<KeyType, char>>& keys)
+    {
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            const bool last = (i + 1 == keys.size());
+            Key(keys[i], last || keys[i+1].first == KeyType::right || keys[i+1].first == KeyType::end);
+        }
+        session.OutStream() << std::flush;
+    }
+
+    // The lines received at once are executed one after the other, with a single
+    // write of the echo for each one, as long as the terminal shows an empty line:
+    // otherwise (e.g., something typed before, or the pager) they go key by key.
+    void LinesEntered(const std::vector<std::string>& lines)
+    {
+        for (const auto& line: lines)
+        {
+            if (!session.Paging() && terminal.Empty())
+                NewCommand(terminal.Line(line));
+            else
+            {
+                for (char c: line)
+                    Key(std::make_pair(KeyType::ascii, c), false);
+                Key(std::make_pair(KeyType::ret, ' '), false);
+            }
+        }
+        if (!session.Paging() && session.AutoSuggestions())
+            terminal.Suggest(session.Suggestion(terminal.GetLine()));
+        session.OutStream() << std::flush;
+    }
+
+    void Key(std::pair<KeyType, char> k, bool suggest = true)
+    {
+        if (session.Paging())
+            PagerKeypressed(k);
+        else
+        {
+            const std::pair<Symbol,std::string> s = terminal.Keypressed(k);
+            NewCommand(s);
+            if (suggest && s.first != Symbol::eof && session.AutoSuggestions())
+                terminal.Suggest(session.Suggestion(terminal.GetLine()));
+        }
     }
 
     void NewCommand(const std::pair<Symbol, std::string>& s)
@@ -76,7 +126,10 @@ private:
             case Symbol::command:
             {
                 session.Feed(s.second);
-                session.Prompt();
+                if (session.Paging())
+                    terminal.More();
+                else
+                    session.Prompt();
                 break;
             }
             case Symbol::down:
@@ -118,10 +171,34 @@ private:
                 terminal.SetLine( line );
                 break;
             }
+            default:
+                break;
         }
 
     }
 
+    void PagerKeypressed(std::pair<KeyType, char> k)
+    {
+        const std::pair<Symbol,std::string> s = terminal.PagerKeypressed(k);
+        switch (s.first)
+        {
+            case Symbol::nextPage: session.PagerNextPage(); break;
+            case Symbol::nextLine: session.PagerShow(1); break;
+            case Symbol::search: session.PagerSearch(s.second); break;
+            case Symbol::quit: session.PagerStop(); break;
+            case Symbol::eof:
+                session.PagerStop();
+                session.Exit();
+                return;
+            default:
+                return;
+        }
+        if (session.Paging())
+            terminal.More();
+        else
+            session.Prompt();
+    }
+
     CliSession& session;
     Terminal terminal;
 };
@@ -32,6 +32,7 @@
 
 #include <thread>
 #include <memory>
+#include <vector>
 
 #include <cstdio>
 #include <termios.h>
@@ -119,14 +120,23 @@ public:
 
 private:
 
+    // Reads all the characters available at once, and notifies their keys with a single task
+    // (e.g., the whole text pasted in the terminal)
     void Read() noexcept
     {
         try
         {
             while (true)
             {
-                auto k = Get();
-                Notify(k);
+                is.WaitKbHit();
+                char buffer[4096];
+                const auto n = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+                std::vector<std::pair<KeyType,char>> keys;
+                if (n <= 0)
+                    keys.emplace_back(KeyType::eof, ' ');
+                for (ssize_t i = 0; i < n; ++i)
+                    Decode(buffer[i], keys);
+                NotifyKeys(std::move(keys));
             }
         }
         catch(const std::exception&)
@@ -135,50 +145,55 @@ private:
         }        
     }
 
-    std::pair<KeyType,char> Get()
+    // Adds to keys the key completed by ch, if any
+    // (the escape sequences can be split among more reads)
+    void Decode(char ch, std::vector<std::pair<KeyType,char>>& keys)
     {
-        is.WaitKbHit();
-
-        int ch = std::getchar();
-        switch(ch)
+        const int c = static_cast<unsigned char>(ch);
+        switch (step)
         {
-            case EOF:
-            case 4:  // EOT
-                return std::make_pair(KeyType::eof,' ');
+            case Step::key:
+                switch(c)
+                {
+                    case 4:  // EOT
+                        keys.emplace_back(KeyType::eof,' '); break;
+                    case 127:
+                    case 8:
+                        keys.emplace_back(KeyType::backspace,' '); break;
+                    case 10: keys.emplace_back(KeyType::ret,' '); break;
+                    case 27: step = Step::escape; break; // symbol
+                    default: keys.emplace_back(KeyType::ascii,ch); break;
+                }
                 break;
-            case 127:
-            case 8:
-                return std::make_pair(KeyType::backspace,' '); break;
-            case 10: return std::make_pair(KeyType::ret,' '); break;
-            case 27: // symbol
-                ch = std::getchar();
-                if ( ch == 91 ) // arrow keys
+            case Step::escape: // got 27
+                if ( c == 91 ) // arrow keys
+                    step = Step::bracket;
+                else
                 {
-                    ch = std::getchar();
-                    switch( ch )
-                    {
-                        case 51:
-                            ch = std::getchar();
-                            if ( ch == 126 ) return std::make_pair(KeyType::canc,' ');
-                            else return std::make_pair(KeyType::ignored,' ');
-                            break;
-                        case 65: return std::make_pair(KeyType::up,' ');
-                        case 66: return std::make_pair(KeyType::down,' ');
-                        case 68: return std::make_pair(KeyType::left,' ');
-                        case 67: return std::make_pair(KeyType::right,' ');
-                        case 70: return std::make_pair(KeyType::end,' ');
-                        case 72: return std::make_pair(KeyType::home,' ');
-                        default: return std::make_pair(KeyType::ignored,' ');
-                    }
+                    step = Step::key;
+                    keys.emplace_back(KeyType::ignored,' ');
                 }
                 break;
-            default: // ascii
-            {
-                const char c = static_cast<char>(ch);
-                return std::make_pair(KeyType::ascii,c);
-            }
+            case Step::bracket: // got 27 and 91
+                step = Step::key;
+                switch( c )
+                {
+                    case 51: step = Step::tilde; break;
+                    case 65: keys.emplace_back(KeyType::up,' '); break;
+                    case 66: keys.emplace_back(KeyType::down,' '); break;
+                    case 68: keys.emplace_back(KeyType::left,' '); break;
+                    case 67: keys.emplace_back(KeyType::right,' '); break;
+                    case 70: keys.emplace_back(KeyType::end,' '); break;
+                    case 72: keys.emplace_back(KeyType::home,' '); break;
+                    default: keys.emplace_back(KeyType::ignored,' '); break;
+                }
+                break;
+            case Step::tilde: // got 27, 91 and 51
+                step = Step::key;
+                if ( c == 126 ) keys.emplace_back(KeyType::canc,' ');
+                else keys.emplace_back(KeyType::ignored,' ');
+                break;
         }
-        return std::make_pair(KeyType::ignored,' ');
     }
 
     void ToManualMode()
@@ -197,6 +212,8 @@ private:
         tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
     }
 
+    enum class Step { key, escape, bracket, tilde };
+    Step step = Step::key; // of the escape sequence being read
     termios oldt;
     termios newt;
     InputSource is;
@@ -0,0 +1,204 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#ifndef CLI_DETAIL_LOCALSERVER_H_
+#define CLI_DETAIL_LOCALSERVER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "server.h"
+
+// unix domain sockets, where asio supports them (but not on windows, that lacks the file permissions)
+#if (defined(BOOST_ASIO_HAS_LOCAL_SOCKETS) || defined(ASIO_HAS_LOCAL_SOCKETS)) && !defined(_WIN32)
+#define CLI_DETAIL_LOCAL_SOCKETS
+#endif
+
+#ifdef CLI_DETAIL_LOCAL_SOCKETS
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cli
+{
+namespace detail
+{
+
+// The credentials of the process at the other end of a local connection
+struct PeerCredentials
+{
+    bool known = false; // false if the system does not provide them
+    long pid = -1; // -1 if the system does not provide it
+    long uid = -1;
+    long gid = -1;
+};
+
+#ifdef CLI_DETAIL_LOCAL_SOCKETS
+
+// A server listening on a unix domain socket, for the clients running on the same host.
+// There's no TCP (and no telnet negotiation, if the sessions don't need it): the access is
+// controlled by the permissions of the socket file and by the credentials of the peer process.
+// The connections are accepted and the sessions run in ios.
+template <typename ASIOLIB>
+class LocalServer : public ServerBase
+{
+public:
+    using ContextType = typename ASIOLIB::ContextType;
+
+    // disable value semantics
+    LocalServer( const LocalServer& ) = delete;
+    LocalServer& operator = ( const LocalServer& ) = delete;
+
+    // Create the socket at path (replacing a socket left there by a previous run)
+    // with the permissions specified: by default, only the user of the process can connect.
+    // The socket file is removed when the server is destroyed.
+    LocalServer(ContextType& ios, std::string _path, unsigned permissions = 0600) :
+        context(ios),
+        path(std::move(_path))
+    {
+        asiolib::local::stream_protocol::acceptor acceptor(ios);
+        struct stat info;
+        if (::lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+            ::unlink(path.c_str());
+        const asiolib::local::stream_protocol::endpoint endpoint(path);
+        acceptor.open(endpoint.protocol());
+        acceptor.bind(endpoint);
+        // no one can connect before listen, so there's no window with the default permissions
+        if (::chmod(path.c_str(), static_cast<mode_t>(permissions)) != 0)
+        {
+            const asiolibec::error_code ec(errno, asiolibec::system_category());
+            acceptor.close();
+            ::unlink(path.c_str());
+            throw asiolibec::system_error(ec, "chmod");
+        }
+        acceptor.listen();
+        listener = std::make_unique<Listener>(std::move(acceptor));
+        Accept();
+    }
+    virtual ~LocalServer()
+    {
+        ::unlink(path.c_str());
+    }
+    // returns shared_ptr instead of unique_ptr because Session needs to use enable_shared_from_this
+    virtual std::shared_ptr<Session> CreateSession(asiolib::generic::stream_protocol::socket socket, const PeerCredentials& peer) = 0;
+
+    // Accept only the connections from the processes for which f returns true
+    // (by default, all the processes allowed by the permissions of the socket).
+    // The connections refused are closed without creating a session.
+    void Peers(std::function<bool(const PeerCredentials&)> f)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        peers = std::move(f);
+    }
+
+    // Set the maximum number of sessions open at the same time (0 means no limit).
+    // The connections exceeding the limit are closed as soon as accepted,
+    // after sending them message (if not empty).
+    void Admission(std::size_t maxSessions, std::string message = {})
+    {
+        Limits(maxSessions, 0, std::move(message));
+    }
+
+    // Returns the path of the socket
+    const std::string& Path() const { return path; }
+
+    // Returns the credentials of the peer of socket
+    static PeerCredentials Credentials(asiolib::local::stream_protocol::socket& socket)
+    {
+        PeerCredentials result;
+#if defined(SO_PEERCRED)
+        struct ucred cred;
+        socklen_t length = sizeof(cred);
+        if (::getsockopt(socket.native_handle(), SOL_SOCKET, SO_PEERCRED, &cred, &length) == 0)
+        {
+            result.known = true;
+            result.pid = static_cast<long>(cred.pid);
+            result.uid = static_cast<long>(cred.uid);
+            result.gid = static_cast<long>(cred.gid);
+        }
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+        uid_t uid;
+        gid_t gid;
+        if (::getpeereid(socket.native_handle(), &uid, &gid) == 0)
+        {
+            result.known = true;
+            result.uid = static_cast<long>(uid);
+            result.gid = static_cast<long>(gid);
+        }
+#else
+        (void)socket;
+#endif
+        return result;
+    }
+
+private:
+
+    using Listener = BasicListener<asiolib::local::stream_protocol::acceptor, asiolib::local::stream_protocol::socket>;
+
+    void Accept()
+    {
+        listener->Accept(
+            [this](){ return std::make_unique<asiolib::local::stream_protocol::socket>(context); },
+            [this](asiolib::local::stream_protocol::socket& socket)
+            {
+                const auto peer = Credentials(socket);
+                std::function<bool(const PeerCredentials&)> allowed;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    allowed = peers;
+                }
+                if (auto ticket = Admit(socket, std::string(), allowed && !allowed(peer)))
+                {
+                    auto session = CreateSession(std::move(socket), peer);
+                    session->ticket = std::move(ticket);
+                    SetTimeouts(*session, timers);
+                    session->Start();
+                }
+            },
+            limits);
+    }
+
+    ContextType& context;
+    const std::string path;
+    std::unique_ptr<Listener> listener;
+    std::shared_ptr<SessionTimers> timers = std::make_shared<SessionTimers>(context);
+    std::mutex mutex; // for peers
+    std::function<bool(const PeerCredentials&)> peers;
+};
+
+#endif // CLI_DETAIL_LOCAL_SOCKETS
+
+} // namespace detail
+} // namespace cli
+
+#endif // CLI_DETAIL_LOCALSERVER_H_
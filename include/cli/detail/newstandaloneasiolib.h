@@ -32,6 +32,7 @@
 
 #include <asio/version.hpp>
 #include <asio.hpp>
+#include <memory>
 
 namespace cli
 {
@@ -76,6 +77,34 @@ public:
     }
 };
 
+// Submits a function for execution to the executor of an I/O object (e.g., a socket)
+template <typename IoObject, typename F>
+void PostOn(IoObject& ioObject, F&& f)
+{
+    asio::post(ioObject.get_executor(), std::forward<F>(f));
+}
+
+// Creates a timer running on the same context of an I/O object
+template <typename IoObject>
+std::unique_ptr<asiolib::steady_timer> NewTimer(IoObject& ioObject)
+{
+    return std::make_unique<asiolib::steady_timer>(ioObject.get_executor());
+}
+
+// Sets the expiry time of a timer relative to now
+template <typename Duration>
+void ExpiresAfter(asiolib::steady_timer& timer, Duration duration)
+{
+    timer.expires_after(duration);
+}
+
+// Calls f(error_code) when a socket has data to read (or it's closed)
+template <typename Socket, typename F>
+void AsyncWaitReadable(Socket& socket, F&& f)
+{
+    socket.async_wait(asiolib::socket_base::wait_read, std::forward<F>(f));
+}
+
 } // namespace detail
 } // namespace cli
 
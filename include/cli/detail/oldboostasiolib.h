@@ -31,6 +31,7 @@
 #define CLI_DETAIL_OLDBOOSTASIOLIB_H_
 
 #include <boost/asio.hpp>
+#include <memory>
 
 namespace cli
 {
@@ -71,6 +72,34 @@ public:
 
 };
 
+// Submits a function for execution to the executor of an I/O object (e.g., a socket)
+template <typename IoObject, typename F>
+void PostOn(IoObject& ioObject, F&& f)
+{
+    ioObject.get_io_service().post(std::forward<F>(f));
+}
+
+// Creates a timer running on the same context of an I/O object
+template <typename IoObject>
+std::unique_ptr<asiolib::steady_timer> NewTimer(IoObject& ioObject)
+{
+    return std::make_unique<asiolib::steady_timer>(ioObject.get_io_service());
+}
+
+// Sets the expiry time of a timer relative to now
+template <typename Duration>
+void ExpiresAfter(asiolib::steady_timer& timer, Duration duration)
+{
+    timer.expires_from_now(duration);
+}
+
+// Calls f(error_code) when a socket has data to read (or it's closed)
+template <typename Socket, typename F>
+void AsyncWaitReadable(Socket& socket, F&& f)
+{
+    socket.async_read_some(asiolib::null_buffers(), [f](asiolibec::error_code ec, std::size_t){ f(ec); });
+}
+
 } // namespace detail
 } // namespace cli
 
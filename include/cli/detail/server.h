@@ -30,126 +30,1337 @@
 #ifndef CLI_DETAIL_SERVER_H_
 #define CLI_DETAIL_SERVER_H_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <queue>
+#include <thread>
+#include <vector>
+#include "bufferpool.h"
+#include "genericasioscheduler.h"
+#include "outputsink.h"
+#include "timerwheel.h"
+#ifdef CLI_USE_ZLIB
+#include "deflater.h"
+#endif
+
+// SO_REUSEPORT balances the connections among the acceptors only on linux
+#if defined(__linux__) && defined(SO_REUSEPORT)
+#define CLI_DETAIL_REUSEPORT
+#endif
 
 namespace cli
 {
+
+// What a session does with new output when the data waiting to be sent
+// exceeds its high watermark (i.e., the client does not keep up).
+enum class SendOverflowPolicy
+{
+    block,     // the producer waits until the queue goes below the low watermark
+               // (where it cannot wait, the session is closed at 4 times the high watermark)
+    drop,      // the output is discarded until the queue goes below the low watermark
+    disconnect // the session is closed
+};
+
+// Where the sessions of a sharded server run (see Server)
+enum class ShardMode
+{
+    io,      // only the I/O: the commands and the output of all the sessions run in the main context
+    sessions // everything: the commands run in the shard too, so their handlers must be thread safe
+};
+
+// Counters of the output of Cli::cout() to the remote sessions
+struct BroadcastStats
+{
+    std::uint64_t sent = 0;    // messages sent
+    std::uint64_t dropped = 0; // lines discarded because the session did not keep up
+    std::size_t queued = 0;    // messages waiting to be sent
+};
+
+// Counters of the connections of a server
+struct ServerStats
+{
+    std::size_t active = 0;     // sessions open
+    std::uint64_t accepted = 0; // connections accepted
+    std::uint64_t rejected = 0; // connections refused because of the limits of the server
+    std::uint64_t errors = 0;   // failed accepts (e.g., too many open files)
+};
+
 namespace detail
 {
 
-class Session : public std::enable_shared_from_this<Session>, public std::streambuf
+// Totals of the broadcast counters of a group of sessions
+struct BroadcastCounters
+{
+    std::atomic<std::uint64_t> sent{0};
+    std::atomic<std::uint64_t> dropped{0};
+};
+
+template <typename ASIOLIB> class Server;
+template <typename ASIOLIB> class LocalServer;
+
+// The data received by a session: a view of its receive buffer,
+// valid only until OnDataReceived returns
+class ReceivedData
+{
+public:
+    ReceivedData(const char* _data, std::size_t _size) : first(_data), length(_size) {}
+    const char* data() const { return first; }
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const char* begin() const { return first; }
+    const char* end() const { return first + length; }
+    char operator[](std::size_t i) const { return first[i]; }
+    std::string str() const { return std::string(first, length); }
+private:
+    const char* first;
+    std::size_t length;
+};
+
+// A std::deque that holds memory only while it's not empty.
+// The queues of a session are empty most of the time, while an empty std::deque
+// can keep its map and a block of elements (e.g., about 600 bytes with libstdc++).
+// As with std::deque, pushing does not move the elements already queued.
+template <typename T>
+class LazyDeque
+{
+public:
+    using iterator = typename std::deque<T>::iterator;
+
+    bool empty() const { return !items || items->empty(); }
+    std::size_t size() const { return items ? items->size() : 0; }
+    T& front() { return items->front(); }
+    iterator begin() { return items ? items->begin() : iterator(); }
+    iterator end() { return items ? items->end() : iterator(); }
+
+    void push_back(T item)
+    {
+        if (!items)
+            items = std::make_unique<std::deque<T>>();
+        items->push_back(std::move(item));
+    }
+    void pop_front()
+    {
+        items->pop_front();
+        Release();
+    }
+    void erase(iterator first, iterator last)
+    {
+        if (first == last)
+            return;
+        items->erase(first, last);
+        Release();
+    }
+    void clear() { items.reset(); }
+
+private:
+    void Release()
+    {
+        if (items->empty())
+            items.reset();
+    }
+    std::unique_ptr<std::deque<T>> items; // null when empty
+};
+
+// When a session is closed for inactivity or for its duration (0 means no limit),
+// and the message sent warning before closing it (if warning is not 0).
+struct SessionTimeouts
+{
+    std::chrono::milliseconds idle{0};     // without receiving data
+    std::chrono::milliseconds absolute{0}; // since the connection
+    std::chrono::milliseconds warning{0};
+    std::string message;
+
+    bool Enabled() const { return idle.count() > 0 || absolute.count() > 0; }
+
+    // The resolution of the deadlines: 1/16 of the shortest timeout, between 10ms and 1s
+    std::chrono::steady_clock::duration Tick() const
+    {
+        auto shortest = std::chrono::milliseconds(1000 * 16);
+        for (auto t: { idle, absolute, warning })
+            if (t.count() > 0)
+                shortest = std::min(shortest, t);
+        return std::min(std::max(shortest / 16, std::chrono::milliseconds(10)), std::chrono::milliseconds(1000));
+    }
+};
+
+// The deadlines of the sessions running in a context, in a timer wheel driven by a
+// single timer of the context, that is armed only while some deadline is pending.
+// NB: must be used only in the thread of the context
+class SessionTimers : public std::enable_shared_from_this<SessionTimers>
+{
+public:
+    template <typename Context>
+    explicit SessionTimers(Context& context) : timer(std::make_unique<asiolib::steady_timer>(context)) {}
+
+    // Schedules f at deadline, with the resolution tick.
+    // Returns 0 if the timers have been stopped.
+    TimerWheel::Handle Add(std::chrono::steady_clock::time_point deadline, std::chrono::steady_clock::duration tick, std::function<void()> f)
+    {
+        if (stopped)
+            return 0;
+        if (!wheel || (wheel->Empty() && wheel->Tick() != tick))
+            wheel = std::make_unique<TimerWheel>(tick, slots);
+        const auto handle = wheel->Add(deadline, std::move(f));
+        Arm();
+        return handle;
+    }
+
+    void Cancel(TimerWheel::Handle handle)
+    {
+        if (wheel)
+            wheel->Cancel(handle);
+    }
+
+    // Discards the deadlines pending, and the ones added from now on
+    void Stop()
+    {
+        stopped = true;
+        wheel.reset();
+        timer->cancel();
+    }
+
+private:
+    void Arm()
+    {
+        if (armed || !wheel || wheel->Empty())
+            return;
+        armed = true;
+        ExpiresAfter(*timer, std::max(wheel->Next() - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero()));
+        std::weak_ptr<SessionTimers> weak = shared_from_this();
+        timer->async_wait([weak](asiolibec::error_code ec)
+            {
+                auto self = weak.lock();
+                if (ec || !self || !self->wheel)
+                    return;
+                self->armed = false;
+                self->wheel->Advance(std::chrono::steady_clock::now());
+                self->Arm();
+            });
+    }
+
+    enum { slots = 512 };
+    std::unique_ptr<asiolib::steady_timer> timer;
+    std::unique_ptr<TimerWheel> wheel; // created with the resolution of the first deadline
+    bool armed = false;
+    bool stopped = false;
+};
+
+class Session : public std::enable_shared_from_this<Session>, public std::streambuf, public OutputSink
 {
 public:
     ~Session() override = default;
     virtual void Start()
     {
+        ioThread = std::this_thread::get_id();
+        if (!outputPost)
+            outputThread = ioThread.load();
+        asiolibec::error_code ec;
+        socket.non_blocking(true, ec); // a read after a spurious wake up (see Read) must not block
+        if (timers)
+        {
+            started = lastInput = std::chrono::steady_clock::now();
+            ScheduleTimeout();
+        }
         OnConnect();
         Read();
     }
 
+    // Set the limits of the queue of data waiting to be sent (in bytes)
+    // and what to do when the client does not keep up.
+    // NB: the block policy cannot stop the thread that runs the session itself,
+    // so the output produced there is queued up to 4 times the high watermark,
+    // then the session is closed as with the disconnect policy (the output of
+    // Cli::cout(), that must not wait for a single session, has its own limit:
+    // see BroadcastLimit).
+    void SendQueue(std::size_t highWatermark, std::size_t lowWatermark, SendOverflowPolicy policy)
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        sendHighWatermark = highWatermark;
+        sendLowWatermark = std::min(lowWatermark, highWatermark);
+        sendPolicy = policy;
+    }
+
+    // Set the limits for the output of Cli::cout() to this session:
+    // at most maxQueued messages wait to be sent (when the queue is full, the
+    // oldest ones are dropped and replaced by a single "N lines suppressed" line)
+    // and at most linesPerSecond messages are sent per second (0 means no limit).
+    // The output of the session itself (e.g., the echo and the prompt) is not limited.
+    // The counters of all the sessions are added up in totals, if not null.
+    void BroadcastLimit(std::size_t maxQueued, double linesPerSecond, std::shared_ptr<BroadcastCounters> totals = {})
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        broadcastMaxQueued = std::max<std::size_t>(maxQueued, 1);
+        broadcastRate = linesPerSecond;
+        broadcastTokens = std::max(linesPerSecond, 1.0);
+        broadcastTotals = std::move(totals);
+    }
+
+#ifdef CLI_USE_ZLIB
+    // Returns the bytes of output before and after the compression (see StartCompression)
+    std::pair<std::uint64_t, std::uint64_t> CompressionBytes()
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        if (!deflater)
+            return std::make_pair(0, 0);
+        return std::make_pair(deflater->In(), deflater->Out());
+    }
+#endif
+
+    BroadcastStats Broadcasts()
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        BroadcastStats result = broadcastStats;
+        result.queued = broadcastQueue.size();
+        return result;
+    }
+
 protected:
 
-    explicit Session(asiolib::ip::tcp::socket _socket) : socket(std::move(_socket)), outStream( this ) {}
+    // a tcp socket, or a unix domain socket (see LocalServer)
+    explicit Session(asiolib::generic::stream_protocol::socket _socket) : socket(std::move(_socket)), outStream( this ) {}
 
+    // The session is closed when all the data queued so far has been sent
     virtual void Disconnect()
     {
-        socket.shutdown(asiolib::ip::tcp::socket::shutdown_both);
-        socket.close();
+        if (InOutputThread())
+            Flush();
+        std::lock_guard<std::mutex> lock(sendMutex);
+        disconnecting = true;
+        if (writing)
+            return;
+        if (std::this_thread::get_id() == ioThread)
+            CloseSocket();
+        else
+        {
+            auto self( shared_from_this() );
+            PostOn(socket, [this, self](){ CloseSocket(); });
+        }
     }
 
+    // The session waits for the data without a receive buffer, that is taken from
+    // the pool just to read the data arrived: the idle sessions don't hold one.
     virtual void Read()
     {
       auto self( shared_from_this() );
-      socket.async_read_some(asiolib::buffer( data, max_length ),
-          [ this, self ]( asiolibec::error_code ec, std::size_t length )
+      AsyncWaitReadable(socket,
+          [ this, self ]( asiolibec::error_code ec )
           {
+              std::size_t length = 0;
+              if ( !ec && socket.is_open() )
+              {
+                  receiveBuffer = BufferPool::Shared()->Get(receiveSize);
+                  length = socket.read_some(asiolib::buffer( receiveBuffer.Data(), receiveBuffer.Size() ), ec);
+                  if ( ( ec == asiolib::error::would_block ) || ( ec == asiolib::error::try_again ) )
+                  {
+                      receiveBuffer = {};
+                      Read();
+                      return;
+                  }
+              }
               if ( !socket.is_open() || ( ec == asiolib::error::eof ) || ( ec == asiolib::error::connection_reset ) )
+              {
+                  CancelTimeout();
+                  receiveBuffer = {};
+                  SendClosed();
                   OnDisconnect();
+              }
               else if ( ec )
+              {
+                  CancelTimeout();
+                  receiveBuffer = {};
+                  SendClosed();
                   OnError();
+              }
               else
               {
-                  OnDataReceived( std::string( data, length ));
+                  if (timers)
+                      lastInput = std::chrono::steady_clock::now();
+                  OnDataReceived( ReceivedData( receiveBuffer.Data(), length ));
+                  AdaptReceiveBuffer( length );
+                  receiveBuffer = {};
                   Read();
               }
           });
     }
 
-    virtual void Send(const std::string& msg)
+    // Queues the message to be sent asynchronously
+    virtual void Send(std::string msg)
     {
-        asiolibec::error_code ec;
-        asiolib::write(socket, asiolib::buffer(msg), ec);
-        if ((ec == asiolib::error::eof) || (ec == asiolib::error::connection_reset))
-            OnDisconnect();
-        else if (ec)
-            OnError();
+        Enqueue(Chunk{std::move(msg), {}, false}, true);
+    }
+
+    // Queues the message to be sent as it is, without passing it through Encode
+    // (e.g., protocol commands)
+    void SendRaw(std::string msg)
+    {
+        if (InOutputThread())
+            Flush();
+        Enqueue(Chunk{std::move(msg), {}, true}, true);
+    }
+
+#ifdef CLI_USE_ZLIB
+    // Sends marker as it is, then compresses all the following output with zlib
+    void StartCompression(std::string marker, int level)
+    {
+        if (InOutputThread())
+            Flush();
+        Chunk chunk{std::move(marker), {}, true};
+        chunk.compressionLevel = level;
+        Enqueue(std::move(chunk), true);
     }
+#endif
 
     virtual std::ostream& OutStream() { return outStream; }
 
+    // Submits f to the thread that writes the output of the session:
+    // the I/O thread, unless the session belongs to a sharded server (see Server).
+    void PostOutput(std::function<void()> f)
+    {
+        if (outputPost)
+            outputPost(std::move(f));
+        else
+            PostOn(socket, std::move(f));
+    }
+
     virtual void OnConnect() = 0;
     virtual void OnDisconnect() = 0;
     virtual void OnError() = 0;
-    virtual void OnDataReceived(const std::string& _data) = 0;
+    virtual void OnDataReceived(const ReceivedData& _data) = 0;
 
-    virtual std::string Encode(const std::string& _data) const { return _data; }
+    // Appends to buffers the data to send on the wire for the output _data.
+    // The buffers can refer to _data, that is kept alive until the write completes.
+    virtual void Encode(const std::string& _data, std::vector<asiolib::const_buffer>& buffers) const
+    {
+        buffers.push_back(asiolib::buffer(_data));
+    }
+
+    // Sends the output buffered so far
+    void Flush()
+    {
+        if (pptr() == pbase())
+            return;
+        Send(std::string(pbase(), pptr()));
+        // the buffer goes back to the pool, so that the idle sessions don't keep one:
+        // the next character goes through overflow, that takes a buffer again
+        outBuffer = {};
+        setp(nullptr, nullptr);
+    }
 
 private:
 
+    // OutputSink
+    // The shared output (e.g., of Cli::cout()) is queued without copying it.
+    // Since each session is independent from the others, the producer is never blocked:
+    // the messages wait in a bounded queue, that is moved to the send queue
+    // when the client keeps up and the rate limit allows it.
+    void Deliver(const std::shared_ptr<const std::string>& text) override
+    {
+        const bool inOutputThread = InOutputThread();
+        if (inOutputThread)
+            Flush(); // keep the order with the output of this session
+        std::lock_guard<std::mutex> lock(sendMutex);
+        if (sendClosed || disconnecting)
+            return;
+        broadcastQueue.push_back(text);
+        if (broadcastQueue.size() > broadcastMaxQueued)
+        {
+            const auto& oldest = *broadcastQueue.front();
+            const auto lines = std::max<std::uint64_t>(static_cast<std::uint64_t>(std::count(oldest.begin(), oldest.end(), '\n')), 1);
+            suppressedLines += lines;
+            broadcastStats.dropped += lines;
+            if (broadcastTotals)
+                broadcastTotals->dropped += lines;
+            broadcastQueue.pop_front();
+        }
+        if (inOutputThread || std::this_thread::get_id() == ioThread)
+            Pump();
+        else
+            PostPump();
+    }
+
+    // NB: must be called with sendMutex locked
+    void PostPump()
+    {
+        if (pumpPosted)
+            return;
+        pumpPosted = true;
+        auto self( shared_from_this() );
+        PostOn(socket, [this, self](){ std::lock_guard<std::mutex> l(sendMutex); pumpPosted = false; Pump(); });
+    }
+
+    // Moves the messages of Cli::cout() in the send queue, as long as the client keeps up
+    // and the rate limit allows it.
+    // NB: must be called in the I/O thread or in the output thread, with sendMutex locked
+    void Pump()
+    {
+        if (sendClosed || disconnecting)
+            return;
+        if (broadcastRate > 0)
+        {
+            const auto now = std::chrono::steady_clock::now();
+            const std::chrono::duration<double> elapsed = now - lastRefill;
+            lastRefill = now;
+            broadcastTokens = std::min(broadcastTokens + elapsed.count() * broadcastRate, std::max(broadcastRate, 1.0));
+        }
+        while (!broadcastQueue.empty() && queuedBytes <= sendLowWatermark && (broadcastRate <= 0 || broadcastTokens >= 1))
+        {
+            Push(Chunk{{}, std::move(broadcastQueue.front()), false});
+            broadcastQueue.pop_front();
+            if (broadcastRate > 0)
+                broadcastTokens -= 1;
+            ++broadcastStats.sent;
+            if (broadcastTotals)
+                ++broadcastTotals->sent;
+        }
+        if (broadcastQueue.empty() && suppressedLines > 0 && queuedBytes <= sendLowWatermark)
+        {
+            // the session has caught up
+            Push(Chunk{"[" + std::to_string(suppressedLines) + " lines suppressed]\n", {}, false});
+            suppressedLines = 0;
+        }
+        if (!broadcastQueue.empty() && broadcastRate > 0 && broadcastTokens < 1 && !timerArmed)
+        {
+            if (std::this_thread::get_id() != ioThread)
+            {
+                PostPump(); // the timer belongs to the I/O thread
+                return;
+            }
+            // wait for the next token
+            if (!timer)
+                timer = NewTimer(socket);
+            timerArmed = true;
+            const auto wait = std::chrono::duration<double>((1 - broadcastTokens) / broadcastRate);
+            ExpiresAfter(*timer, std::chrono::duration_cast<std::chrono::steady_clock::duration>(wait));
+            auto self( shared_from_this() );
+            timer->async_wait([this, self](asiolibec::error_code){
+                std::lock_guard<std::mutex> l(sendMutex);
+                timerArmed = false;
+                Pump();
+            });
+        }
+    }
+
+    struct Chunk
+    {
+        std::string owned;
+        std::shared_ptr<const std::string> shared;
+        bool raw;
+        int compressionLevel = -2; // if >= -1, the output after this chunk is compressed
+        const std::string& Data() const { return shared ? *shared : owned; }
+    };
+
+    void Enqueue(Chunk chunk, bool mayBlock)
+    {
+        const auto size = chunk.Data().size();
+        if (size == 0)
+            return;
+        std::unique_lock<std::mutex> lock(sendMutex);
+        if (sendCongested)
+        {
+            switch (sendPolicy)
+            {
+                case SendOverflowPolicy::block:
+                    if (mayBlock && std::this_thread::get_id() != ioThread && !InOutputThread())
+                        sendCv.wait(lock, [this](){ return !sendCongested || sendClosed; });
+                    else if (queuedBytes + size > 4 * sendHighWatermark)
+                    {
+                        // the thread cannot wait, and the client is not reading
+                        Overflow(lock);
+                        return;
+                    }
+                    break;
+                case SendOverflowPolicy::drop:
+                    return;
+                case SendOverflowPolicy::disconnect:
+                    Overflow(lock);
+                    return;
+            }
+        }
+        if (sendClosed || disconnecting)
+            return;
+        Push(std::move(chunk));
+    }
+
+    // Closes the session that does not keep up with its output
+    void Overflow(std::unique_lock<std::mutex>& lock)
+    {
+        if (sendClosed)
+            return;
+        SendClosed(lock);
+        auto self( shared_from_this() );
+        PostOn(socket, [this, self](){ CloseSocket(); });
+    }
+
+    // Adds the chunk to the send queue and starts writing, if needed.
+    // NB: must be called with sendMutex locked
+    void Push(Chunk chunk)
+    {
+        queuedBytes += chunk.Data().size();
+        sendQueue.push_back(std::move(chunk));
+        if (queuedBytes > sendHighWatermark)
+            sendCongested = true;
+        if (writing)
+            return;
+        writing = true;
+        if (std::this_thread::get_id() == ioThread)
+            Write();
+        else
+        {
+            auto self( shared_from_this() );
+            PostOn(socket, [this, self](){ std::lock_guard<std::mutex> l(sendMutex); Write(); });
+        }
+    }
+
+
     // std::streambuf
+    // The output is buffered and sent with a single write when the stream is flushed,
+    // when the buffer is full or, at the latest, when the current asio handler returns.
     std::streamsize xsputn( const char* s, std::streamsize n ) override
     {
-        Send(Encode(std::string(s, s+n)));
-        return n;
+        const auto size = static_cast<std::size_t>(n);
+        if (size >= outBufferSize) // no point in copying it in the buffer
+        {
+            Flush();
+            Send(std::string(s, s+n));
+            return n;
+        }
+        return std::streambuf::xsputn(s, n);
     }
     int overflow( int c ) override
     {
-        Send(Encode(std::string(1, static_cast< char >(c))));
+        if (traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::not_eof(c);
+        Flush(); // the buffer is full
+        outBuffer = BufferPool::Shared()->Get(outBufferSize);
+        setp(outBuffer.Data(), outBuffer.Data() + outBuffer.Size());
+        ScheduleFlush();
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
         return c;
     }
+    int sync() override
+    {
+        Flush();
+        return 0;
+    }
 
-    asiolib::ip::tcp::socket socket;
-    enum { max_length = 1024 };
-    char data[ max_length ];
+    // Sends with a single write everything queued so far.
+    // NB: must be called with sendMutex locked
+    void Write()
+    {
+        if (sendClosed)
+        {
+            writing = false;
+            sendQueue.clear();
+            queuedBytes = 0;
+            return;
+        }
+        if (sendQueue.empty())
+        {
+            writing = false;
+            if (disconnecting)
+                CloseSocket();
+            return;
+        }
+        std::vector<asiolib::const_buffer> buffers;
+        buffers.reserve(sendQueue.size());
+#ifdef CLI_USE_ZLIB
+        std::size_t uncompressed = 0; // number of buffers before the start of the compression
+#endif
+        for (const auto& chunk: sendQueue)
+        {
+            if (chunk.raw)
+                buffers.push_back(asiolib::buffer(chunk.Data()));
+            else
+                Encode(chunk.Data(), buffers);
+#ifdef CLI_USE_ZLIB
+            if (!deflater)
+            {
+                uncompressed = buffers.size();
+                if (chunk.compressionLevel >= -1)
+                    deflater = std::make_unique<Deflater>(chunk.compressionLevel);
+            }
+#endif
+        }
+#ifdef CLI_USE_ZLIB
+        if (deflater)
+        {
+            // the whole batch is flushed: the peer must be able to show it now
+            compressed.clear();
+            for (auto i = buffers.begin() + static_cast<std::ptrdiff_t>(uncompressed); i != buffers.end(); ++i)
+                deflater->Compress(static_cast<const char*>(i->data()), i->size(), compressed);
+            deflater->Flush(compressed);
+            buffers.resize(uncompressed);
+            buffers.push_back(asiolib::buffer(compressed));
+        }
+#endif
+        const std::size_t n = sendQueue.size();
+        auto self( shared_from_this() );
+        asiolib::async_write(socket, buffers,
+            [this, self, n](asiolibec::error_code ec, std::size_t /*length*/)
+            {
+                std::unique_lock<std::mutex> lock(sendMutex);
+                if (ec)
+                {
+                    SendClosed(lock);
+                    Write(); // cleanup
+                    lock.unlock();
+                    if ((ec == asiolib::error::eof) || (ec == asiolib::error::connection_reset))
+                        OnDisconnect();
+                    else if (ec != asiolib::error::operation_aborted)
+                        OnError();
+                    return;
+                }
+                const auto sent = sendQueue.begin() + static_cast<std::ptrdiff_t>(n);
+                for (auto i = sendQueue.begin(); i != sent; ++i)
+                    queuedBytes -= i->Data().size();
+                sendQueue.erase(sendQueue.begin(), sent);
+                if (sendCongested && queuedBytes <= sendLowWatermark)
+                {
+                    sendCongested = false;
+                    sendCv.notify_all();
+                }
+                writing = false;
+                Pump();
+                if (!writing)
+                {
+                    writing = true;
+                    Write();
+                }
+            });
+    }
+
+    // Stops sending (the data not sent yet is discarded) and wakes up the blocked producers.
+    void SendClosed()
+    {
+        std::unique_lock<std::mutex> lock(sendMutex);
+        SendClosed(lock);
+    }
+    void SendClosed(std::unique_lock<std::mutex>& lock)
+    {
+        sendClosed = true;
+        broadcastQueue.clear();
+        if (!writing) // otherwise, the queue is still in use by async_write
+        {
+            sendQueue.clear();
+            queuedBytes = 0;
+        }
+        lock.unlock();
+        sendCv.notify_all();
+        lock.lock();
+    }
+
+    void CloseSocket()
+    {
+        if (timer)
+            timer->cancel();
+        asiolibec::error_code ec;
+        socket.shutdown(asiolib::socket_base::shutdown_both, ec);
+        socket.close(ec);
+    }
+
+    // The receive buffer doubles when a read fills it (e.g., the client is pasting
+    // a lot of text), and halves after some reads that use less than a quarter of it.
+    // The buffers come from the pool shared by the sessions, so a read does not
+    // allocate, as long as the pool has a buffer of the size needed.
+    void AdaptReceiveBuffer(std::size_t length)
+    {
+        const auto size = receiveBuffer.Size();
+        if (length == size && size < BufferPool::Shared()->MaxSize())
+            receiveSize = size * 2;
+        else if (length <= size / 4 && size > BufferPool::Shared()->MinSize() && ++smallReads >= 16)
+            receiveSize = size / 2;
+        else
+        {
+            if (length > size / 4)
+                smallReads = 0;
+            return;
+        }
+        smallReads = 0;
+    }
+
+    // The time when the session expires
+    std::chrono::steady_clock::time_point Deadline() const
+    {
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        if (timeouts.idle.count() > 0)
+            deadline = lastInput + timeouts.idle;
+        if (timeouts.absolute.count() > 0)
+            deadline = std::min(deadline, started + timeouts.absolute);
+        return deadline;
+    }
+
+    // Schedules the next check of the timeouts: at the deadline, or at the warning before it.
+    // The input received in the meantime only moves lastInput, so that the wheel
+    // is not touched at every read.
+    // NB: must be called in the I/O thread
+    void ScheduleTimeout()
+    {
+        const auto deadline = Deadline();
+        auto at = deadline;
+        if (timeouts.warning.count() > 0 && warned != deadline)
+            at = deadline - timeouts.warning;
+        std::weak_ptr<Session> weak = shared_from_this();
+        timeoutHandle = timers->Add(at, timeouts.Tick(), [weak]()
+            {
+                if (auto self = weak.lock())
+                    self->CheckTimeout();
+            });
+    }
+
+    void CheckTimeout()
+    {
+        timeoutHandle = 0;
+        const auto now = std::chrono::steady_clock::now();
+        const auto deadline = Deadline();
+        auto self( shared_from_this() );
+        if (now >= deadline)
+        {
+            PostOutput([this, self](){ Disconnect(); });
+            return;
+        }
+        if (timeouts.warning.count() > 0 && warned != deadline && now >= deadline - timeouts.warning)
+        {
+            warned = deadline;
+            if (!timeouts.message.empty())
+                PostOutput([this, self](){ OutStream() << timeouts.message << std::flush; });
+        }
+        ScheduleTimeout();
+    }
+
+    void CancelTimeout()
+    {
+        if (timers && timeoutHandle != 0)
+            timers->Cancel(timeoutHandle);
+        timeoutHandle = 0;
+    }
+
+    // flushes the output after the current handler
+    void ScheduleFlush()
+    {
+        if (flushScheduled)
+            return;
+        flushScheduled = true;
+        auto self( shared_from_this() );
+        PostOutput([this, self](){ flushScheduled = false; Flush(); });
+    }
+
+    // true in the thread that writes the output of the session (see PostOutput)
+    bool InOutputThread() const
+    {
+        return std::this_thread::get_id() == outputThread;
+    }
+
+    friend class ServerBase;
+    template <typename ASIOLIB> friend class Server;
+    template <typename ASIOLIB> friend class LocalServer;
+
+    std::shared_ptr<void> context; // the owner of the context of socket, if it must outlive the server
+    std::shared_ptr<void> ticket; // the place of the session in the limits of its server
+    asiolib::generic::stream_protocol::socket socket;
+    BufferPool::Buffer receiveBuffer; // taken only to read the data arrived
+    std::size_t receiveSize = 0; // of the next receive buffer (0 is the minimum)
+    unsigned smallReads = 0; // reads using less than a quarter of the receive buffer, in a row
+    enum { outBufferSize = 4096 };
+    BufferPool::Buffer outBuffer; // taken by the first write, until the flush
+    bool flushScheduled = false;
     std::ostream outStream;
+    std::function<void(std::function<void()>)> outputPost; // set for the sessions of a server sharded with ShardMode::io
+
+    // timeouts (see Server::Timeouts)
+    std::shared_ptr<SessionTimers> timers; // of the I/O context, null if the session never expires
+    SessionTimeouts timeouts;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point lastInput;
+    std::chrono::steady_clock::time_point warned; // the deadline already warned
+    TimerWheel::Handle timeoutHandle = 0;
+
+    // asynchronous send queue
+    std::atomic<std::thread::id> ioThread{ std::thread::id{} };
+    std::atomic<std::thread::id> outputThread{ std::thread::id{} }; // none until it's known
+    std::mutex sendMutex;
+    std::condition_variable sendCv;
+    LazyDeque<Chunk> sendQueue;
+    std::size_t queuedBytes = 0;
+    std::size_t sendHighWatermark = 1024 * 1024;
+    std::size_t sendLowWatermark = 256 * 1024;
+    SendOverflowPolicy sendPolicy = SendOverflowPolicy::block;
+    bool sendCongested = false;
+    bool writing = false;
+    bool disconnecting = false;
+    bool sendClosed = false;
+
+    // output of Cli::cout()
+    LazyDeque<std::shared_ptr<const std::string>> broadcastQueue;
+    std::size_t broadcastMaxQueued = 1000;
+    double broadcastRate = 0; // lines per second (0 means no limit)
+    double broadcastTokens = 1;
+    std::chrono::steady_clock::time_point lastRefill = std::chrono::steady_clock::now();
+    std::uint64_t suppressedLines = 0;
+    bool pumpPosted = false;
+    std::unique_ptr<asiolib::steady_timer> timer; // for the rate limit
+    bool timerArmed = false;
+    BroadcastStats broadcastStats;
+    std::shared_ptr<BroadcastCounters> broadcastTotals;
+
+#ifdef CLI_USE_ZLIB
+    std::unique_ptr<Deflater> deflater; // compression of the output, if started
+    std::string compressed; // the output being written, when compressed
+#endif
+};
+
+
+// The limits of the sessions of a server, shared with the tickets of the sessions
+struct Admissions
+{
+    std::mutex mutex;
+    std::size_t maxSessions = 0; // 0 means no limit
+    std::size_t maxPerAddress = 0; // 0 means no limit
+    std::string message; // sent to the connections refused
+    std::map<std::string, std::size_t> perAddress; // the sessions open from each (known) address
+    ServerStats stats;
+    SessionTimeouts timeouts;
 };
 
+// An acceptor with the socket for the next connection
+template <typename ACCEPTOR, typename SOCKET>
+struct BasicListener
+{
+    explicit BasicListener(ACCEPTOR _acceptor) : acceptor(std::move(_acceptor)) {}
+
+    // Accepts the next connection in the socket returned by newSocket, calls accepted with it
+    // and starts again. After an error (e.g., too many open files) it retries later,
+    // waiting longer and longer, up to one second (the errors are counted in limits).
+    template <typename NEWSOCKET, typename ACCEPTED>
+    void Accept(NEWSOCKET newSocket, ACCEPTED accepted, std::shared_ptr<Admissions> limits)
+    {
+        socket = newSocket();
+        acceptor.async_accept(*socket, [this, newSocket, accepted, limits](asiolibec::error_code ec)
+            {
+                if (ec == asiolib::error::operation_aborted || !acceptor.is_open())
+                    return;
+                if (ec)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(limits->mutex);
+                        ++limits->stats.errors;
+                    }
+                    backoff = std::min(std::max(backoff * 2, std::chrono::milliseconds(10)), std::chrono::milliseconds(1000));
+                    ExpiresAfter(*timer, backoff);
+                    timer->async_wait([this, newSocket, accepted, limits](asiolibec::error_code e)
+                        {
+                            if (!e)
+                                Accept(newSocket, accepted, limits);
+                        });
+                    return;
+                }
+                backoff = std::chrono::milliseconds(0);
+                accepted(*socket);
+                Accept(newSocket, accepted, limits);
+            });
+    }
+
+    ACCEPTOR acceptor;
+    std::unique_ptr<SOCKET> socket;
+    std::unique_ptr<asiolib::steady_timer> timer = NewTimer(acceptor); // to retry after an error
+    std::chrono::milliseconds backoff{0};
+};
+
+// What the servers (see Server and LocalServer) have in common:
+// the limits of the sessions and their timeouts.
+class ServerBase
+{
+public:
+
+    ServerStats Stats() const
+    {
+        std::lock_guard<std::mutex> lock(limits->mutex);
+        return limits->stats;
+    }
+
+    // Close the new sessions that receive no data for idle, or that are open for longer than
+    // absolute (0 means no limit). If warning is not 0, message is sent to the session
+    // warning before it's closed. The deadlines of the sessions are kept in a timer wheel
+    // for each thread, with a resolution of 1/16 of the shortest timeout (between 10ms and 1s).
+    void Timeouts(std::chrono::milliseconds idle, std::chrono::milliseconds absolute,
+                  std::chrono::milliseconds warning = std::chrono::milliseconds(0), std::string message = {})
+    {
+        std::lock_guard<std::mutex> lock(limits->mutex);
+        limits->timeouts.idle = idle;
+        limits->timeouts.absolute = absolute;
+        limits->timeouts.warning = warning;
+        limits->timeouts.message = std::move(message);
+    }
+
+protected:
+
+    ServerBase() = default;
+    ~ServerBase() = default;
+
+    // disable value semantics
+    ServerBase( const ServerBase& ) = delete;
+    ServerBase& operator = ( const ServerBase& ) = delete;
+
+    // the place of a session within the limits, released when the session is destroyed
+    struct Ticket
+    {
+        Ticket(std::shared_ptr<Admissions> _admissions, std::string _address) :
+            admissions(std::move(_admissions)), address(std::move(_address)) {}
+        ~Ticket()
+        {
+            std::lock_guard<std::mutex> lock(admissions->mutex);
+            --admissions->stats.active;
+            if (address.empty())
+                return;
+            auto i = admissions->perAddress.find(address);
+            if (i != admissions->perAddress.end() && --i->second == 0)
+                admissions->perAddress.erase(i);
+        }
+        std::shared_ptr<Admissions> admissions;
+        std::string address;
+    };
+
+    void Limits(std::size_t maxSessions, std::size_t maxSessionsPerAddress, std::string message)
+    {
+        std::lock_guard<std::mutex> lock(limits->mutex);
+        limits->maxSessions = maxSessions;
+        limits->maxPerAddress = maxSessionsPerAddress;
+        limits->message = std::move(message);
+    }
+
+    // Returns the ticket of the new connection from address (empty if unknown),
+    // or null if the connection is refused or it exceeds the limits of the server:
+    // then it's closed (after sending the message of the limits, if not refused).
+    template <typename SOCKET>
+    std::shared_ptr<Ticket> Admit(SOCKET& socket, const std::string& address, bool refused = false)
+    {
+        std::string message;
+        {
+            std::lock_guard<std::mutex> lock(limits->mutex);
+            std::size_t* count = address.empty() ? nullptr : &limits->perAddress[address];
+            if (!refused &&
+                (limits->maxSessions == 0 || limits->stats.active < limits->maxSessions) &&
+                (limits->maxPerAddress == 0 || count == nullptr || *count < limits->maxPerAddress))
+            {
+                if (count != nullptr)
+                    ++*count;
+                ++limits->stats.active;
+                ++limits->stats.accepted;
+                return std::make_shared<Ticket>(limits, address);
+            }
+            if (count != nullptr && *count == 0)
+                limits->perAddress.erase(address);
+            ++limits->stats.rejected;
+            if (!refused)
+                message = limits->message;
+        }
+        // the connection is closed without creating a session
+        asiolibec::error_code ec;
+        if (!message.empty())
+        {
+            socket.non_blocking(true, ec);
+            socket.write_some(asiolib::buffer(message), ec);
+        }
+        socket.shutdown(asiolib::socket_base::shutdown_both, ec);
+        socket.close(ec);
+        return {};
+    }
+
+    // Sets the timeouts of the server on a new session, using the timers t
+    void SetTimeouts(Session& session, const std::shared_ptr<SessionTimers>& t)
+    {
+        std::lock_guard<std::mutex> lock(limits->mutex);
+        if (!limits->timeouts.Enabled())
+            return;
+        session.timeouts = limits->timeouts;
+        session.timers = t;
+    }
+
+    std::shared_ptr<Admissions> limits = std::make_shared<Admissions>();
+};
 
 template <typename ASIOLIB>
-class Server
+class Server : public ServerBase
 {
 public:
+    using ContextType = typename ASIOLIB::ContextType;
+
     // disable value semantics
     Server( const Server& ) = delete;
     Server& operator = ( const Server& ) = delete;
 
-    Server(typename ASIOLIB::ContextType& ios, unsigned short port) :
-        acceptor(ios, asiolib::ip::tcp::endpoint(asiolib::ip::tcp::v4(), port)),
-        socket(ios)
-    {
-        Accept();
-    }
-    Server(typename ASIOLIB::ContextType& ios, std::string address, unsigned short port) :
-        acceptor(ios, asiolib::ip::tcp::endpoint(ASIOLIB::IpAddressFromString(address), port)),
-        socket(ios)
+    // If shards is 0, the server accepts the connections and runs the sessions in ios.
+    // Otherwise, the server starts shards threads, each one with its own context:
+    // a connection is accepted by a shard (each shard has its own acceptor on the same port,
+    // with SO_REUSEPORT, where available) and the I/O of its session runs in that shard only.
+    // The sessions are still created (CreateSession) in ios, that must be run by a single thread.
+    // With ShardMode::io their output is written there too, while with ShardMode::sessions
+    // they run entirely in their shard, with the scheduler of the shard (see CreateSession).
+    Server(ContextType& ios, unsigned short port, std::size_t shards = 0, ShardMode mode = ShardMode::io) :
+        Server(ios, asiolib::ip::tcp::endpoint(asiolib::ip::tcp::v4(), port), shards, mode)
+    {}
+    Server(ContextType& ios, std::string address, unsigned short port, std::size_t shards = 0, ShardMode mode = ShardMode::io) :
+        Server(ios, asiolib::ip::tcp::endpoint(ASIOLIB::IpAddressFromString(address), port), shards, mode)
+    {}
+    virtual ~Server()
     {
-        Accept();
+        *alive = false;
+        // close the acceptors and the sessions in their shard, and wait for the end of the shards
+        for (auto& shard: shards)
+        {
+            auto s = shard.get();
+            typename ASIOLIB::Executor(*s->context).Post([s]()
+            {
+                if (s->listener)
+                {
+                    s->listener->acceptor.close();
+                    s->listener->timer->cancel();
+                }
+                s->timers->Stop();
+                std::lock_guard<std::mutex> lock(s->mutex);
+                for (auto& w: s->sessions)
+                    if (auto session = w.lock())
+                        session->CloseSocket();
+            });
+            s->work.reset();
+        }
+        for (auto& shard: shards)
+            shard->thread.join();
     }
-    virtual ~Server() = default;
     // returns shared_ptr instead of unique_ptr because Session needs to use enable_shared_from_this
     virtual std::shared_ptr<Session> CreateSession(asiolib::ip::tcp::socket socket) = 0;
+    // With ShardMode::sessions, creates a session that runs its tasks in scheduler
+    // (i.e., in the thread of its shard)
+    virtual std::shared_ptr<Session> CreateSession(asiolib::ip::tcp::socket socket, Scheduler& /*scheduler*/)
+    {
+        return CreateSession(std::move(socket));
+    }
+
+    // Set the maximum number of sessions open at the same time,
+    // in total and from the same address (0 means no limit).
+    // The connections exceeding the limits are closed as soon as accepted,
+    // after sending them message (if not empty).
+    void Admission(std::size_t maxSessions, std::size_t maxSessionsPerAddress, std::string message = {})
+    {
+        Limits(maxSessions, maxSessionsPerAddress, std::move(message));
+    }
+
+    // Enable the TCP keepalive on the new connections, so that the peers gone without
+    // closing the connection are detected: the first probe is sent after idle seconds
+    // without traffic, then one every interval seconds, and the connection is dropped after
+    // count probes without answer. The values 0 keep the defaults of the system
+    // (as well as all of them, where the system does not allow to set them).
+    void KeepAlive(std::chrono::seconds idle, std::chrono::seconds interval = std::chrono::seconds(0), int count = 0)
+    {
+        std::lock_guard<std::mutex> lock(limits->mutex);
+        keepAlive = true;
+        keepAliveIdle = idle;
+        keepAliveInterval = interval;
+        keepAliveCount = count;
+    }
+
+    // Returns the endpoint where the connections are accepted (e.g., the actual port when 0 is specified)
+    asiolib::ip::tcp::endpoint LocalEndpoint() const
+    {
+        return shards.empty() ? listener->acceptor.local_endpoint() : shards.front()->listener->acceptor.local_endpoint();
+    }
+
 private:
-    void Accept()
+
+    using WorkGuard = typename ASIOLIB::WorkGuard;
+
+    using Listener = BasicListener<asiolib::ip::tcp::acceptor, asiolib::ip::tcp::socket>;
+
+    static asiolib::ip::tcp::acceptor Open(ContextType& context, const asiolib::ip::tcp::endpoint& endpoint, bool reusePort)
+    {
+        asiolib::ip::tcp::acceptor acceptor(context);
+        acceptor.open(endpoint.protocol());
+        acceptor.set_option(asiolib::ip::tcp::acceptor::reuse_address(true));
+#ifdef CLI_DETAIL_REUSEPORT
+        if (reusePort)
+            acceptor.set_option(asiolib::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+#else
+        (void)reusePort;
+#endif
+        acceptor.bind(endpoint);
+        acceptor.listen();
+        return acceptor;
+    }
+
+    // a thread with its own context, running the sessions it accepts
+    struct Shard
+    {
+        Shard() :
+            context(std::make_shared<ContextType>()),
+            work(std::make_unique<WorkGuard>(ASIOLIB::MakeWorkGuard(*context))),
+            scheduler(*context),
+            timers(std::make_shared<SessionTimers>(*context))
+        {}
+        std::shared_ptr<ContextType> context; // shared with the sessions, that can outlive the server
+        std::unique_ptr<WorkGuard> work;
+        GenericAsioScheduler<ASIOLIB> scheduler; // for the sessions that run in the shard (ShardMode::sessions)
+        std::shared_ptr<SessionTimers> timers; // the timeouts of the sessions of the shard
+        std::unique_ptr<Listener> listener; // null if the shard does not accept connections
+        std::thread thread;
+        std::mutex mutex;
+        std::vector<std::weak_ptr<Session>> sessions;
+    };
+
+    Server(ContextType& ios, const asiolib::ip::tcp::endpoint& endpoint, std::size_t nShards, ShardMode mode) :
+        mainContext(ios),
+        shardMode(mode)
     {
-        acceptor.async_accept(socket, [this](asiolibec::error_code ec)
+        if (nShards == 0)
+        {
+            listener = std::make_unique<Listener>(Open(ios, endpoint, false));
+            Accept(*listener, nullptr);
+            return;
+        }
+        for (std::size_t i = 0; i < nShards; ++i)
+            shards.push_back(std::make_unique<Shard>());
+#ifdef CLI_DETAIL_REUSEPORT
+        // each shard accepts its connections (the first one chooses the port, if 0)
+        auto shardEndpoint = endpoint;
+        for (auto& shard: shards)
+        {
+            shard->listener = std::make_unique<Listener>(Open(*shard->context, shardEndpoint, true));
+            shardEndpoint.port(shard->listener->acceptor.local_endpoint().port());
+            Accept(*shard->listener, shard.get());
+        }
+#else
+        // the first shard accepts the connections for all the shards
+        shards.front()->listener = std::make_unique<Listener>(Open(*shards.front()->context, endpoint, false));
+        Accept(*shards.front()->listener, nullptr);
+#endif
+        for (auto& shard: shards)
+        {
+            auto context = shard->context;
+            shard->thread = std::thread([context](){ context->run(); });
+        }
+    }
+
+    // accepts the connections for shard
+    // (or for the next shard in turn, if shard is null in a sharded server)
+    void Accept(Listener& l, Shard* shard)
+    {
+        l.Accept(
+            [this, shard]()
             {
-                if (!ec) CreateSession(std::move(socket))->Start();
-                Accept();
-            });
+                acceptTarget = shard;
+                if (!shard && !shards.empty())
+                {
+                    acceptTarget = shards[nextShard].get();
+                    nextShard = (nextShard + 1) % shards.size();
+                }
+                return std::make_unique<asiolib::ip::tcp::socket>(acceptTarget ? *acceptTarget->context : mainContext);
+            },
+            [this, shard](asiolib::ip::tcp::socket& socket)
+            {
+                Shard* target = shard ? shard : acceptTarget;
+                asiolibec::error_code ec;
+                const auto remote = socket.remote_endpoint(ec);
+                if (auto ticket = Admit(socket, ec ? std::string() : remote.address().to_string()))
+                    Accepted(std::move(socket), std::move(ticket), target);
+            },
+            limits);
     }
-    asiolib::ip::tcp::acceptor acceptor;
-    asiolib::ip::tcp::socket socket;
+
+    void Accepted(asiolib::ip::tcp::socket socket, std::shared_ptr<Ticket> ticket, Shard* shard)
+    {
+        // the sessions coalesce their output (see Session::Flush), so Nagle would only
+        // delay the large writes, split in more segments, until the peer acks the first one
+        asiolibec::error_code ec;
+        socket.set_option(asiolib::ip::tcp::no_delay(true), ec);
+        SetKeepAlive(socket);
+        if (!shard)
+        {
+            auto session = CreateSession(std::move(socket));
+            session->ticket = std::move(ticket);
+            SetTimeouts(*session, timers);
+            session->Start();
+            return;
+        }
+        // the socket must not outlive its context, even if the server is destroyed in the meantime
+        struct Peer
+        {
+            std::shared_ptr<ContextType> context;
+            asiolib::ip::tcp::socket socket;
+            std::shared_ptr<Ticket> ticket;
+        };
+        auto peer = std::make_shared<Peer>(Peer{shard->context, std::move(socket), std::move(ticket)});
+        auto isAlive = alive;
+        ContextType& ios = mainContext;
+        typename ASIOLIB::Executor(mainContext).Post([this, isAlive, peer, shard, &ios]()
+        {
+            if (!*isAlive)
+                return;
+            std::shared_ptr<Session> session;
+            if (shardMode == ShardMode::sessions)
+                session = CreateSession(std::move(peer->socket), shard->scheduler);
+            else
+            {
+                session = CreateSession(std::move(peer->socket));
+                // the output of the session is written in this thread
+                session->outputThread = std::this_thread::get_id();
+                session->outputPost = [&ios](std::function<void()> f){ typename ASIOLIB::Executor(ios).Post(std::move(f)); };
+            }
+            session->context = shard->context;
+            session->ticket = std::move(peer->ticket);
+            SetTimeouts(*session, shard->timers);
+            {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                auto& v = shard->sessions;
+                v.erase(std::remove_if(v.begin(), v.end(), [](const std::weak_ptr<Session>& w){ return w.expired(); }), v.end());
+                v.push_back(session);
+            }
+            typename ASIOLIB::Executor(*shard->context).Post([session](){ session->Start(); });
+        });
+    }
+
+    void SetKeepAlive(asiolib::ip::tcp::socket& socket)
+    {
+        std::unique_lock<std::mutex> lock(limits->mutex);
+        if (!keepAlive)
+            return;
+        const auto idle = static_cast<int>(keepAliveIdle.count());
+        const auto interval = static_cast<int>(keepAliveInterval.count());
+        const auto count = keepAliveCount;
+        lock.unlock();
+        asiolibec::error_code ec;
+        socket.set_option(asiolib::socket_base::keep_alive(true), ec);
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+        if (idle > 0)
+            socket.set_option(asiolib::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPIDLE>(idle), ec);
+        if (interval > 0)
+            socket.set_option(asiolib::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPINTVL>(interval), ec);
+        if (count > 0)
+            socket.set_option(asiolib::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPCNT>(count), ec);
+#else
+        (void)idle; (void)interval; (void)count;
+#endif
+    }
+
+    ContextType& mainContext;
+    const ShardMode shardMode;
+    // the keepalive of the new connections (protected by limits->mutex)
+    bool keepAlive = false;
+    std::chrono::seconds keepAliveIdle{0};
+    std::chrono::seconds keepAliveInterval{0};
+    int keepAliveCount = 0;
+    std::shared_ptr<SessionTimers> timers = std::make_shared<SessionTimers>(mainContext); // if not sharded
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true); // checked by the handlers posted to mainContext
+    std::unique_ptr<Listener> listener; // if not sharded
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::size_t nextShard = 0;
+    Shard* acceptTarget = nullptr; // of the connection being accepted by the listener that chooses the shard
 };
 
 } // namespace detail
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#ifndef CLI_DETAIL_SHAREDHISTORY_H_
+#define CLI_DETAIL_SHAREDHISTORY_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+namespace cli
+{
+namespace detail
+{
+
+// A bounded append log shared by all the sessions of a Cli.
+// Every session publishes the commands it runs with Append and reads the
+// commands published by the other sessions with Read, using its own Cursor.
+// Appending and reading don't take any lock on the log: writers reserve a
+// slot with an atomic ticket and readers validate the slot sequence number
+// before and after reading the entry.
+// A session reads only the commands of the sessions having its same identity.
+// When the log is full, the oldest entries are overwritten: a cursor lagging
+// behind more than the capacity just skips them.
+class SharedHistory
+{
+public:
+
+    struct Cursor
+    {
+        std::uint64_t next = 0; // ticket of the next entry to read
+        std::uint64_t owner = 0; // the entries published by owner are skipped
+        std::string identity; // only the entries with this identity are read
+    };
+
+    explicit SharedHistory(std::size_t _capacity = 1000) :
+        capacity(_capacity == 0 ? 1 : _capacity),
+        slots(new Slot[capacity])
+    {}
+
+    // disable value semantics
+    SharedHistory(const SharedHistory&) = delete;
+    SharedHistory& operator = (const SharedHistory&) = delete;
+
+    // Returns a new cursor positioned at the end of the log,
+    // so that it will read only the entries published from now on.
+    Cursor NewCursor(const std::string& identity = {})
+    {
+        Cursor c;
+        c.identity = identity;
+        c.next = tail.load();
+        c.owner = ++owners;
+        return c;
+    }
+
+    // Publishes a command on behalf of the owner of the cursor
+    void Append(const Cursor& c, const std::string& cmd)
+    {
+        auto entry = std::make_shared<const Entry>(Entry{cmd, c.owner, c.identity});
+        const auto ticket = tail.fetch_add(1);
+        Slot& slot = slots[ticket % capacity];
+        const auto previous = ticket < capacity ? 0 : Published(ticket - capacity);
+        while (slot.seq.load() != previous)
+            std::this_thread::yield();
+        slot.seq.store(Published(ticket) - 1); // the slot is being written
+        std::atomic_store(&slot.entry, std::shared_ptr<const Entry>(std::move(entry)));
+        slot.seq.store(Published(ticket));
+    }
+
+    // Calls f for every command published by the other sessions
+    // after the last call, from the oldest to the newest.
+    template <typename F>
+    void Read(Cursor& c, F&& f) const
+    {
+        const auto end = tail.load();
+        if (end - c.next > capacity) // overwritten entries
+            c.next = end - capacity;
+        for (; c.next != end; ++c.next)
+        {
+            const Slot& slot = slots[c.next % capacity];
+            const auto expected = Published(c.next);
+            const auto seq = slot.seq.load();
+            if (seq < expected) // still being written: we'll get it next time
+                break;
+            if (seq > expected) // overwritten by a newer entry
+                continue;
+            const auto entry = std::atomic_load(&slot.entry);
+            if (slot.seq.load() != expected) // overwritten while reading
+                continue;
+            if (entry->owner != c.owner && entry->identity == c.identity)
+                f(entry->command);
+        }
+    }
+
+private:
+
+    struct Entry
+    {
+        std::string command;
+        std::uint64_t owner;
+        std::string identity;
+    };
+
+    struct Slot
+    {
+        std::atomic<std::uint64_t> seq{0}; // Published(ticket) of the entry, minus 1 while writing
+        std::shared_ptr<const Entry> entry;
+    };
+
+    // the sequence number of the slot when the entry of ticket is readable
+    static std::uint64_t Published(std::uint64_t ticket) { return 2 * (ticket + 1); }
+
+    const std::size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<std::uint64_t> tail{0};
+    std::atomic<std::uint64_t> owners{0};
+};
+
+} // namespace detail
+} // namespace cli
+
+#endif // CLI_DETAIL_SHAREDHISTORY_H_
@@ -0,0 +1,224 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#ifndef CLI_DETAIL_SUGGESTIONINDEX_H_
+#define CLI_DETAIL_SUGGESTIONINDEX_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+namespace cli
+{
+namespace detail
+{
+
+// A prefix index of the commands, ranked by frecency, used to get
+// the best completion of the line the user is typing.
+// Every use of a command adds to its score a weight that grows exponentially
+// with the number of commands recorded (halving the relevance of a use every
+// halfLife commands). This way, the score of a command changes only when it's
+// used, and it can only increase: each node of the trie keeps its best command
+// and both Add and Suggestion cost O(length of the command).
+class SuggestionIndex
+{
+public:
+
+    explicit SuggestionIndex(std::size_t _maxSize = 1000, double halfLife = 50) :
+        maxSize(_maxSize),
+        growth(std::pow(2.0, 1.0 / halfLife))
+    {}
+
+    // disable value semantics
+    SuggestionIndex(const SuggestionIndex&) = delete;
+    SuggestionIndex& operator = (const SuggestionIndex&) = delete;
+
+    // Records a use of the command
+    void Add(const std::string& cmd)
+    {
+        if (cmd.empty())
+            return;
+        auto& entry = *scores.emplace(cmd, 0.0).first;
+        entry.second += weight;
+        weight *= growth;
+        Update(entry);
+        if (weight > maxWeight)
+            Rescale();
+        if (scores.size() > 2 * maxSize)
+            Shrink();
+    }
+
+    // Returns the best command starting with prefix and longer than it,
+    // or the empty string if there is no such command.
+    std::string Suggestion(const std::string& prefix) const
+    {
+        if (prefix.empty())
+            return {};
+        const Node* n = &root;
+        for (char c: prefix)
+        {
+            n = n->Child(c);
+            if (n == nullptr)
+                return {};
+        }
+        if (n->best == nullptr || n->best->first.size() == prefix.size())
+            return {};
+        return n->best->first;
+    }
+
+private:
+
+    using Entry = std::pair<const std::string, double>;
+
+    struct Node
+    {
+        const Node* Child(char c) const
+        {
+            for (const auto& child: children)
+                if (child.first == c)
+                    return child.second.get();
+            return nullptr;
+        }
+        Node* ChildOrNew(char c)
+        {
+            for (auto& child: children)
+                if (child.first == c)
+                    return child.second.get();
+            children.emplace_back(c, std::make_unique<Node>());
+            return children.back().second.get();
+        }
+        std::vector<std::pair<char, std::unique_ptr<Node>>> children;
+        const Entry* best = nullptr;
+    };
+
+    // the score of entry has increased: update the best of the nodes on its path
+    void Update(const Entry& entry)
+    {
+        Node* n = &root;
+        for (char c: entry.first)
+        {
+            n = n->ChildOrNew(c);
+            if (n->best == nullptr || n->best->second <= entry.second)
+                n->best = &entry;
+        }
+    }
+
+    // scales down all the scores, preserving their order
+    void Rescale()
+    {
+        for (auto& s: scores)
+            s.second /= maxWeight;
+        weight /= maxWeight;
+    }
+
+    // keeps only the best maxSize commands
+    void Shrink()
+    {
+        std::vector<std::pair<std::string, double>> entries(scores.begin(), scores.end());
+        std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b){ return a.second > b.second; });
+        entries.resize(maxSize);
+        scores.clear();
+        root = Node();
+        // the lowest scores first, so that the ties go to the newest
+        std::for_each(entries.rbegin(), entries.rend(), [this](const auto& e){ Update(*scores.emplace(e).first); });
+    }
+
+    static constexpr double maxWeight = 1e100;
+    const std::size_t maxSize;
+    const double growth;
+    double weight = 1.0;
+    std::unordered_map<std::string, double> scores; // pointers to the entries are stable
+    Node root;
+};
+
+// The suggestion indexes shared by the sessions of a Cli: one for each identity,
+// kept as long as a session uses it. The sessions can run in different threads,
+// so every index is used under its own mutex.
+class SharedSuggestions
+{
+public:
+
+    class Index
+    {
+    public:
+        void Add(const std::string& cmd)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            index.Add(cmd);
+        }
+        std::string Suggestion(const std::string& prefix) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return index.Suggestion(prefix);
+        }
+    private:
+        mutable std::mutex mutex;
+        SuggestionIndex index;
+    };
+
+    SharedSuggestions() = default;
+
+    // disable value semantics
+    SharedSuggestions(const SharedSuggestions&) = delete;
+    SharedSuggestions& operator = (const SharedSuggestions&) = delete;
+
+    // Returns the index of the sessions with the given identity.
+    // If no session is using it, a new index is filled with the (stored) commands.
+    std::shared_ptr<Index> Get(const std::string& identity, const std::vector<std::string>& commands)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = indexes.find(identity);
+        if (it != indexes.end())
+            if (auto index = it->second.lock())
+                return index;
+        // a new index: drop the ones no longer used
+        for (auto i = indexes.begin(); i != indexes.end();)
+            i = i->second.expired() ? indexes.erase(i) : std::next(i);
+        auto index = std::make_shared<Index>();
+        for (const auto& c: commands)
+            index->Add(c);
+        indexes[identity] = index;
+        return index;
+    }
+
+private:
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<Index>> indexes;
+};
+
+} // namespace detail
+} // namespace cli
+
+#endif // CLI_DETAIL_SUGGESTIONINDEX_H_
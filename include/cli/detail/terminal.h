@@ -30,6 +30,7 @@
 #ifndef CLI_DETAIL_TERMINAL_H_
 #define CLI_DETAIL_TERMINAL_H_
 
+#include <algorithm>
 #include <string>
 #include "../colorprofile.h"
 #include "inputdevice.h"
@@ -46,39 +47,77 @@ enum class Symbol
     up,
     down,
     tab,
-    eof
+    eof,
+    // pager
+    nextPage,
+    nextLine,
+    quit,
+    search
 };
 
 class Terminal
 {
   public:
-    explicit Terminal(std::ostream &_out) : out(_out) {}
+    // ansi tells if the terminal understands the ANSI cursor sequences
+    explicit Terminal(std::ostream &_out, bool _ansi = true) : out(_out), ansi(_ansi), colors(out) {}
 
-    void ResetCursor() { position = 0; }
+    // The terminal now shows an empty line (e.g., after a new prompt)
+    void ResetCursor()
+    {
+        currentLine.clear();
+        position = 0;
+    }
 
     void SetLine(const std::string &newLine)
     {
-        out << beforeInput
-            << std::string(position, '\b') << newLine
-            << afterInput << std::flush;
+        HideSuggestion();
+        Redraw(newLine, newLine.size());
+    }
 
-        // if newLine is shorter then currentLine, we have
-        // to clear the rest of the string
-        if (newLine.size() < currentLine.size())
-        {
-            out << std::string(currentLine.size() - newLine.size(), ' ');
-            // and go back
-            out << std::string(currentLine.size() - newLine.size(), '\b') << std::flush;
-        }
+    std::string GetLine() const { return currentLine; }
 
-        currentLine = newLine;
-        position = currentLine.size();
+    // Returns true if the terminal shows an empty input line, with nothing else pending
+    bool Empty() const { return currentLine.empty() && suggested.empty() && !searching; }
+
+    // Shows a whole line entered on an empty terminal line (e.g., pasted or pipelined)
+    // and returns it as a command: the same as typing its characters followed by return.
+    std::pair<Symbol, std::string> Line(const std::string& line)
+    {
+        Write(line);
+        out << "\r\n";
+        return std::make_pair(Symbol::command, line);
     }
 
-    std::string GetLine() const { return currentLine; }
+    // Show the rest of the suggested line after the cursor (in gray, if the colors are enabled),
+    // if the cursor is at the end of the line and suggestion starts with the line.
+    // The suggestion is accepted with the right arrow or end keys.
+    void Suggest(const std::string& suggestion)
+    {
+        if (position == currentLine.size() &&
+            suggestion.size() > currentLine.size() &&
+            suggestion.compare(0, currentLine.size(), currentLine) == 0)
+        {
+            suggested = suggestion.substr(currentLine.size());
+            const auto& c = colors.Get();
+            out << c.beforeSuggestion << suggested << c.afterSuggestion;
+            Back(suggested.size());
+        }
+    }
 
+    // Updates the line for the key pressed.
+    // The output is not flushed, so that the caller can send everything at once.
     std::pair<Symbol, std::string> Keypressed(std::pair<KeyType, char> k)
     {
+        if (!suggested.empty())
+        {
+            if (k.first == KeyType::right || k.first == KeyType::end)
+            {
+                AcceptSuggestion();
+                return std::make_pair(Symbol::nothing, std::string());
+            }
+            HideSuggestion();
+        }
+
         switch (k.first)
         {
             case KeyType::eof:
@@ -89,19 +128,9 @@ class Terminal
                 if (position == 0)
                     break;
 
-                --position;
-
-                const auto pos = static_cast<std::string::difference_type>(position);
-                // remove the char from buffer
-                currentLine.erase(currentLine.begin() + pos);
-                // go back to the previous char
-                out << '\b';
-                // output the rest of the line
-                out << std::string(currentLine.begin() + pos, currentLine.end());
-                // remove last char
-                out << ' ';
-                // go back to the original position
-                out << std::string(currentLine.size() - position + 1, '\b') << std::flush;
+                auto line = currentLine;
+                line.erase(position - 1, 1);
+                Redraw(line, position - 1);
                 break;
             }
             case KeyType::up:
@@ -112,19 +141,11 @@ class Terminal
                 break;
             case KeyType::left:
                 if (position > 0)
-                {
-                    out << '\b' << std::flush;
-                    --position;
-                }
+                    MoveTo(position - 1);
                 break;
             case KeyType::right:
                 if (position < currentLine.size())
-                {
-                    out << beforeInput
-                        << currentLine[position]
-                        << afterInput << std::flush;
-                    ++position;
-                }
+                    MoveTo(position + 1);
                 break;
             case KeyType::ret:
             {
@@ -142,20 +163,9 @@ class Terminal
                     return std::make_pair(Symbol::tab, std::string());
                 else
                 {
-                    const auto pos = static_cast<std::string::difference_type>(position);
-
-                    // output the new char:
-                    out << beforeInput << c;
-                    // and the rest of the string:
-                    out << std::string(currentLine.begin() + pos, currentLine.end())
-                        << afterInput;
-
-                    // go back to the original position
-                    out << std::string(currentLine.size() - position, '\b') << std::flush;
-
-                    // update the buffer and cursor position:
-                    currentLine.insert(currentLine.begin() + pos, c);
-                    ++position;
+                    auto line = currentLine;
+                    line.insert(position, 1, c);
+                    Redraw(line, position + 1);
                 }
 
                 break;
@@ -165,34 +175,17 @@ class Terminal
                 if (position == currentLine.size())
                     break;
 
-                const auto pos = static_cast<std::string::difference_type>(position);
-
-                // output the rest of the line
-                out << std::string(currentLine.begin() + pos + 1, currentLine.end());
-                // remove last char
-                out << ' ';
-                // go back to the original position
-                out << std::string(currentLine.size() - position, '\b') << std::flush;
-                // remove the char from buffer
-                currentLine.erase(currentLine.begin() + pos);
+                auto line = currentLine;
+                line.erase(position, 1);
+                Redraw(line, position);
                 break;
             }
             case KeyType::end:
-            {
-                const auto pos = static_cast<std::string::difference_type>(position);
-
-                out << beforeInput
-                    << std::string(currentLine.begin() + pos, currentLine.end())
-                    << afterInput << std::flush;
-                position = currentLine.size();
+                MoveTo(currentLine.size());
                 break;
-            }
             case KeyType::home:
-            {
-                out << std::string(position, '\b') << std::flush;
-                position = 0;
+                MoveTo(0);
                 break;
-            }
             case KeyType::ignored:
                 // TODO
                 break;
@@ -201,10 +194,222 @@ class Terminal
         return std::make_pair(Symbol::nothing, std::string());
     }
 
+    // Shows the pager prompt, waiting for the user to ask for more output
+    void More()
+    {
+        Write(more);
+    }
+
+    // Handles the keys pressed while the pager prompt is shown:
+    // space for the next page, return for the next line, q to quit
+    // and / followed by a pattern to search it.
+    std::pair<Symbol, std::string> PagerKeypressed(std::pair<KeyType, char> k)
+    {
+        if (k.first == KeyType::eof)
+            return std::make_pair(Symbol::eof, std::string{});
+
+        if (searching)
+        {
+            switch (k.first)
+            {
+                case KeyType::ret:
+                {
+                    searching = false;
+                    ClearLine(currentLine.size() + 1);
+                    auto pattern = currentLine;
+                    currentLine.clear();
+                    return std::make_pair(Symbol::search, pattern);
+                }
+                case KeyType::backspace:
+                    if (currentLine.empty())
+                    {
+                        // back to the pager prompt
+                        searching = false;
+                        ClearLine(1);
+                        More();
+                    }
+                    else
+                    {
+                        currentLine.pop_back();
+                        out << "\b \b";
+                    }
+                    break;
+                case KeyType::ascii:
+                    currentLine += k.second;
+                    out << k.second;
+                    break;
+                default:
+                    break;
+            }
+            return std::make_pair(Symbol::nothing, std::string{});
+        }
+
+        if (k.first == KeyType::ret)
+        {
+            ClearLine(more.size());
+            return std::make_pair(Symbol::nextLine, std::string{});
+        }
+        if (k.first != KeyType::ascii)
+            return std::make_pair(Symbol::nothing, std::string{});
+        switch (k.second)
+        {
+            case ' ':
+                ClearLine(more.size());
+                return std::make_pair(Symbol::nextPage, std::string{});
+            case 'q':
+            case 'Q':
+                ClearLine(more.size());
+                return std::make_pair(Symbol::quit, std::string{});
+            case '/':
+                ClearLine(more.size());
+                searching = true;
+                currentLine.clear();
+                out << '/';
+                break;
+            default:
+                break;
+        }
+        return std::make_pair(Symbol::nothing, std::string{});
+    }
+
   private:
+
+    // clears the first n characters of the current line
+    void ClearLine(std::size_t n)
+    {
+        if (ansi)
+            out << "\r\x1b[K";
+        else
+            out << '\r' << std::string(n, ' ') << '\r';
+    }
+
+    // Changes the line shown from currentLine to newLine, with the cursor in newPosition.
+    // Only the characters between the common prefix and the common suffix are written:
+    // with ANSI the suffix is shifted by the terminal (ICH/DCH) instead of being rewritten.
+    void Redraw(const std::string& newLine, std::size_t newPosition)
+    {
+        const std::size_t oldSize = currentLine.size();
+        const std::size_t newSize = newLine.size();
+        const std::size_t shorter = std::min(oldSize, newSize);
+        std::size_t prefix = 0;
+        while (prefix < shorter && currentLine[prefix] == newLine[prefix])
+            ++prefix;
+        std::size_t suffix = 0;
+        while (suffix < shorter && currentLine[oldSize - 1 - suffix] == newLine[newSize - 1 - suffix])
+            ++suffix;
+        if (prefix + suffix > shorter)
+        {
+            // the change can be placed in more positions (e.g., "aaa" -> "aa"):
+            // take the nearest to the cursor
+            prefix = std::max(shorter - suffix, std::min(prefix, std::min(position, newPosition)));
+            suffix = shorter - prefix;
+        }
+        const std::size_t oldMiddle = oldSize - prefix - suffix;
+        const std::size_t newMiddle = newSize - prefix - suffix;
+
+        if (oldMiddle != 0 || newMiddle != 0)
+        {
+            MoveTo(prefix);
+            if (oldMiddle == newMiddle)
+            {
+                // same length: overwrite the changed characters
+                Write(newLine.substr(prefix, newMiddle));
+                position = prefix + newMiddle;
+            }
+            else if (ansi && suffix > 2) // for shorter suffixes rewriting costs less
+            {
+                if (newMiddle > oldMiddle)
+                    out << "\x1b[" << newMiddle - oldMiddle << '@'; // ICH
+                Write(newLine.substr(prefix, newMiddle));
+                if (newMiddle < oldMiddle)
+                    out << "\x1b[" << oldMiddle - newMiddle << 'P'; // DCH
+                position = prefix + newMiddle;
+            }
+            else
+            {
+                Write(newLine.substr(prefix));
+                position = newSize;
+                if (oldSize > newSize)
+                {
+                    if (ansi)
+                        out << "\x1b[K"; // EL
+                    else
+                    {
+                        out << std::string(oldSize - newSize, ' ');
+                        Back(oldSize - newSize);
+                    }
+                }
+            }
+        }
+        currentLine = newLine;
+        MoveTo(newPosition);
+    }
+
+    // moves the cursor to the column col of the line shown
+    void MoveTo(std::size_t col)
+    {
+        if (col < position)
+            Back(position - col);
+        else if (col > position)
+        {
+            const std::size_t n = col - position;
+            if (ansi && n > 3)
+                out << "\x1b[" << n << 'C'; // CUF
+            else
+                Write(currentLine.substr(position, n));
+        }
+        position = col;
+    }
+
+    // moves the cursor n columns to the left
+    void Back(std::size_t n)
+    {
+        if (ansi && n > 3)
+            out << "\x1b[" << n << 'D'; // CUB
+        else
+            out << std::string(n, '\b');
+    }
+
+    // writes characters of the input line
+    void Write(const std::string& chars)
+    {
+        if (chars.empty())
+            return;
+        const auto& c = colors.Get();
+        out << c.beforeInput << chars << c.afterInput;
+    }
+
+    void AcceptSuggestion()
+    {
+        Write(suggested);
+        currentLine += suggested;
+        position = currentLine.size();
+        suggested.clear();
+    }
+
+    // the suggestion after the cursor is erased
+    void HideSuggestion()
+    {
+        if (suggested.empty())
+            return;
+        if (ansi)
+            out << "\x1b[K";
+        else
+        {
+            out << std::string(suggested.size(), ' ');
+            Back(suggested.size());
+        }
+        suggested.clear();
+    }
+
     std::string currentLine;
+    std::string suggested; // the part of the suggestion shown after the cursor
     std::size_t position = 0; // next writing position in currentLine
+    bool searching = false; // the user is typing a pattern in the pager (in currentLine)
+    const std::string more = "--More--";
     std::ostream &out;
+    const bool ansi;
+    ColorCache colors;
 };
 
 } // namespace detail
@@ -0,0 +1,211 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#ifndef CLI_DETAIL_TIMERWHEEL_H_
+#define CLI_DETAIL_TIMERWHEEL_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cli
+{
+namespace detail
+{
+
+// A hashed timer wheel: the time is divided in ticks, and each deadline is put
+// in the slot of its tick (modulo the number of slots), with the number of turns
+// of the wheel still to wait. Add and Cancel cost O(1), and each tick only
+// visits the entries of a slot, so that a large number of deadlines
+// (e.g., the timeouts of thousands of sessions) costs a single timer.
+// The deadlines are rounded up to the next tick.
+// The entries live in a vector, linked in a list per slot, and they are reused:
+// a handle carries the generation of its entry, so that a stale handle is ignored.
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Handle = std::uint64_t; // 0 is never a valid handle
+
+    TimerWheel(Clock::duration _tick, std::size_t _slots, Clock::time_point now = Clock::now()) :
+        tick(_tick),
+        slots(std::max<std::size_t>(_slots, 1), none),
+        next(now + _tick)
+    {}
+
+    // disable value semantics
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator = (const TimerWheel&) = delete;
+
+    // Schedules f to be called by Advance at deadline (at the latest, one tick later)
+    Handle Add(Clock::time_point deadline, std::function<void()> f)
+    {
+        std::uint64_t ticks = 1;
+        if (deadline > next)
+            ticks += static_cast<std::uint64_t>((deadline - next + tick - Clock::duration(1)) / tick);
+        std::uint32_t index;
+        if (freeList != none)
+        {
+            index = freeList;
+            freeList = entries[index].next;
+        }
+        else
+        {
+            index = static_cast<std::uint32_t>(entries.size());
+            entries.emplace_back();
+        }
+        Entry& e = entries[index];
+        e.f = std::move(f);
+        e.slot = (cursor + static_cast<std::size_t>((ticks - 1) % slots.size())) % slots.size();
+        e.rounds = (ticks - 1) / slots.size();
+        e.used = true;
+        Link(index);
+        ++size;
+        return (static_cast<Handle>(e.generation) << 32) | index;
+    }
+
+    // Removes the deadline, if still pending. Returns true if it was pending.
+    bool Cancel(Handle handle)
+    {
+        const auto index = static_cast<std::uint32_t>(handle & 0xFFFFFFFF);
+        if (handle == 0 || index >= entries.size())
+            return false;
+        Entry& e = entries[index];
+        if (!e.used || e.generation != static_cast<std::uint32_t>(handle >> 32))
+            return false;
+        Unlink(index);
+        Release(index);
+        return true;
+    }
+
+    // Calls the functions whose deadline is expired at now.
+    // Returns the number of functions called.
+    std::size_t Advance(Clock::time_point now)
+    {
+        std::size_t count = 0;
+        std::vector<std::function<void()>> expired;
+        while (next <= now)
+        {
+            // the functions can add and cancel deadlines
+            for (auto index = slots[cursor]; index != none;)
+            {
+                Entry& e = entries[index];
+                const auto following = e.next;
+                if (e.rounds == 0)
+                {
+                    expired.push_back(std::move(e.f));
+                    Unlink(index);
+                    Release(index);
+                }
+                else
+                    --e.rounds;
+                index = following;
+            }
+            cursor = (cursor + 1) % slots.size();
+            next += tick;
+            for (auto& f: expired)
+                f();
+            count += expired.size();
+            expired.clear();
+        }
+        return count;
+    }
+
+    // Number of deadlines pending
+    std::size_t Size() const { return size; }
+    bool Empty() const { return size == 0; }
+
+    Clock::duration Tick() const { return tick; }
+
+    // The time of the next tick
+    Clock::time_point Next() const { return next; }
+
+private:
+
+    enum : std::uint32_t { none = 0xFFFFFFFF }; // the end of a list
+
+    struct Entry
+    {
+        std::function<void()> f;
+        std::uint64_t rounds = 0; // turns of the wheel still to wait
+        std::size_t slot = 0;
+        std::uint32_t prev = none;
+        std::uint32_t next = none; // also links the free entries
+        std::uint32_t generation = 1;
+        bool used = false;
+    };
+
+    void Link(std::uint32_t index)
+    {
+        Entry& e = entries[index];
+        e.prev = none;
+        e.next = slots[e.slot];
+        if (e.next != none)
+            entries[e.next].prev = index;
+        slots[e.slot] = index;
+    }
+
+    void Unlink(std::uint32_t index)
+    {
+        Entry& e = entries[index];
+        if (e.prev != none)
+            entries[e.prev].next = e.next;
+        else
+            slots[e.slot] = e.next;
+        if (e.next != none)
+            entries[e.next].prev = e.prev;
+    }
+
+    void Release(std::uint32_t index)
+    {
+        Entry& e = entries[index];
+        e.f = nullptr;
+        e.used = false;
+        if (++e.generation == 0)
+            e.generation = 1;
+        e.next = freeList;
+        freeList = index;
+        --size;
+    }
+
+    const Clock::duration tick;
+    std::vector<std::uint32_t> slots; // the first entry of each slot
+    std::vector<Entry> entries;
+    std::uint32_t freeList = none;
+    std::size_t cursor = 0; // the slot of the next tick
+    Clock::time_point next; // the time of the next tick
+    std::size_t size = 0;
+};
+
+} // namespace detail
+} // namespace cli
+
+#endif // CLI_DETAIL_TIMERWHEEL_H_
@@ -34,6 +34,7 @@
 #include <string>
 #include <thread>
 #include <memory>
+#include <vector>
 #include <conio.h>
 #include <cassert>
 
@@ -110,16 +111,23 @@ public:
         servant.join();
     }
 
+    // the legacy console does not interpret the escape sequences
+    bool Ansi() const override { return false; }
+
 private:
 
+    // The keys already available (e.g., the text pasted in the console)
+    // are notified together, with a single task
     void Read() noexcept
     {
         try
         {
             while (true)
             {
-                auto k = Get();
-                Notify(k);
+                std::vector<std::pair<KeyType, char>> keys{ Get() };
+                while (_kbhit() && keys.size() < maxKeys)
+                    keys.push_back(Get());
+                NotifyKeys(std::move(keys));
             }
         }
         catch (const std::exception&)
@@ -172,6 +180,7 @@ private:
         return std::make_pair(KeyType::ignored, ' ');
     }
 
+    enum { maxKeys = 4096 }; // notified at once
     InputSource is;
     std::thread servant;
 };
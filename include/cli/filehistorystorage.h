@@ -33,6 +33,8 @@
 #include "historystorage.h"
 #include <fstream>
 #include <utility>
+#include <unordered_set>
+#include <algorithm>
 
 namespace cli
 {
@@ -40,9 +42,10 @@ namespace cli
 class FileHistoryStorage : public HistoryStorage
 {
 public:
-    explicit FileHistoryStorage(std::string _fileName, std::size_t size = 1000) : 
+    explicit FileHistoryStorage(std::string _fileName, std::size_t size = 1000, HistoryDuplicates _duplicates = HistoryDuplicates::keep) :
         maxSize(size),
-        fileName(std::move(_fileName))
+        fileName(std::move(_fileName)),
+        duplicates(_duplicates)
     {
     }
     void Store(const std::vector<std::string>& cmds) override
@@ -50,6 +53,8 @@ public:
         using dt = std::vector<std::string>::difference_type;
         auto commands = Commands();
         commands.insert(commands.end(), cmds.begin(), cmds.end());
+        if (duplicates == HistoryDuplicates::eraseOlder)
+            EraseOlderDuplicates(commands);
         if (commands.size() > maxSize)
             commands.erase(
                 commands.begin(), 
@@ -77,8 +82,21 @@ public:
     }
 
 private:
+    // keeps only the newest occurrence of each command
+    static void EraseOlderDuplicates(std::vector<std::string>& commands)
+    {
+        std::unordered_set<std::string> found;
+        auto newest = std::remove_if(
+            commands.rbegin(),
+            commands.rend(),
+            [&found](const std::string& c){ return !found.insert(c).second; }
+        );
+        commands.erase(commands.begin(), newest.base());
+    }
+
     const std::size_t maxSize;
     const std::string fileName;
+    const HistoryDuplicates duplicates;
 };
 
 } // namespace cli
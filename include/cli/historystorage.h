@@ -36,6 +36,13 @@
 namespace cli
 {
 
+// Policy for the commands issued again
+enum class HistoryDuplicates
+{
+    keep, // all the occurrences of a command are kept
+    eraseOlder // the older occurrences of a command are erased
+};
+
 class HistoryStorage
 {
 public:
@@ -47,6 +54,12 @@ public:
     // Clear the whole content of the storage
     // After calling this method, Commands() returns the empty vector
     virtual void Clear() = 0;
+    // Store a vector of commands issued by the session with the given identity
+    // The default implementation ignores the identity
+    virtual void StoreFor(const std::string& /*identity*/, const std::vector<std::string>& commands) { Store(commands); }
+    // Returns the commands to load in the session with the given identity
+    // The default implementation ignores the identity
+    virtual std::vector<std::string> CommandsFor(const std::string& /*identity*/) const { return Commands(); }
 };
 
 } // namespace cli
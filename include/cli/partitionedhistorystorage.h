@@ -0,0 +1,160 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#ifndef CLI_PARTITIONEDHISTORYSTORAGE_H_
+#define CLI_PARTITIONEDHISTORYSTORAGE_H_
+
+#include "historystorage.h"
+#include "volatilehistorystorage.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace cli
+{
+
+/**
+ * @brief PartitionedHistoryStorage keeps a separate history for every session identity
+ * (see the @c CliSession constructor), each one with its own size quota.
+ * This way, a session loads only the commands of its own partition, and
+ * a chatty user cannot evict the commands of the others.
+ * The partitions are created on first use by a factory, that by default creates
+ * a @c VolatileHistoryStorage. E.g., to have a persistent history per user:
+ *
+ *     auto storage = std::make_unique<PartitionedHistoryStorage>(
+ *         100,
+ *         [](const std::string& identity, std::size_t quota)
+ *         {
+ *             // the identity can come from a remote client (e.g., "../../etc/x"):
+ *             // hex-encoded, it cannot get out of the directory nor collide with another one
+ *             static const char hex[] = "0123456789abcdef";
+ *             std::string name = ".history_";
+ *             for (unsigned char c: identity)
+ *             {
+ *                 name += hex[c >> 4];
+ *                 name += hex[c & 0xF];
+ *             }
+ *             return std::make_unique<FileHistoryStorage>(name, quota);
+ *         }
+ *     );
+ *
+ * NB: never use the identity in a file name as it is.
+ * The sessions without an identity share the partition with the empty identity.
+ * The methods can be called concurrently by sessions running in different threads.
+ */
+class PartitionedHistoryStorage : public HistoryStorage
+{
+public:
+
+    using Factory = std::function< std::unique_ptr<HistoryStorage>(const std::string& identity, std::size_t quota) >;
+
+    /**
+     * @brief Construct a new PartitionedHistoryStorage object.
+     *
+     * @param _defaultQuota the size of the partitions without a specific quota
+     * @param _factory the function that creates the storage of a partition
+     */
+    explicit PartitionedHistoryStorage(std::size_t _defaultQuota = 100, Factory _factory = {}) :
+        defaultQuota(_defaultQuota),
+        factory(_factory ? std::move(_factory) : DefaultFactory)
+    {}
+
+    /**
+     * @brief Set the size of the partition of the given identity.
+     * It must be called before the partition is used.
+     */
+    void Quota(const std::string& identity, std::size_t quota)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        quotas[identity] = quota;
+    }
+
+    void Store(const std::vector<std::string>& cmds) override
+    {
+        StoreFor({}, cmds);
+    }
+
+    std::vector<std::string> Commands() const override
+    {
+        return CommandsFor({});
+    }
+
+    // Clear the partitions used so far
+    void Clear() override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& p: partitions)
+            p.second->Clear();
+    }
+
+    void StoreFor(const std::string& identity, const std::vector<std::string>& cmds) override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Partition(identity).Store(cmds);
+    }
+
+    std::vector<std::string> CommandsFor(const std::string& identity) const override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return Partition(identity).Commands();
+    }
+
+private:
+
+    static std::unique_ptr<HistoryStorage> DefaultFactory(const std::string& /*identity*/, std::size_t quota)
+    {
+        return std::make_unique<VolatileHistoryStorage>(quota);
+    }
+
+    // mtx must be locked
+    HistoryStorage& Partition(const std::string& identity) const
+    {
+        auto i = partitions.find(identity);
+        if (i == partitions.end())
+        {
+            auto q = quotas.find(identity);
+            const std::size_t quota = (q == quotas.end() ? defaultQuota : q->second);
+            i = partitions.emplace(identity, factory(identity, quota)).first;
+        }
+        return *i->second;
+    }
+
+    const std::size_t defaultQuota;
+    const Factory factory;
+    std::map<std::string, std::size_t> quotas;
+    // partitions are created lazily, even by const methods
+    mutable std::map<std::string, std::unique_ptr<HistoryStorage>> partitions;
+    mutable std::mutex mtx;
+};
+
+} // namespace cli
+
+#endif // CLI_PARTITIONEDHISTORYSTORAGE_H_
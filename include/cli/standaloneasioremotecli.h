@@ -34,6 +34,10 @@
 #include "detail/genericasioremotecli.h"
 
 namespace cli { using StandaloneAsioCliTelnetServer = detail::CliGenericTelnetServer<detail::StandaloneAsioLib>; }
+namespace cli { using StandaloneAsioCliMachineServer = detail::CliGenericMachineServer<detail::StandaloneAsioLib>; }
+#ifdef CLI_DETAIL_LOCAL_SOCKETS
+namespace cli { using StandaloneAsioCliLocalServer = detail::CliGenericLocalServer<detail::StandaloneAsioLib>; }
+#endif
 
 
 #endif // CLI_STANDALONEASIOREMOTECLI_H_
@@ -31,7 +31,9 @@
 #define CLI_VOLATILEHISTORYSTORAGE_H_
 
 #include "historystorage.h"
-#include <deque>
+#include <list>
+#include <unordered_map>
+#include <functional>
 
 namespace cli
 {
@@ -39,16 +41,16 @@ namespace cli
 class VolatileHistoryStorage : public HistoryStorage
 {
     public:
-        explicit VolatileHistoryStorage(std::size_t size = 1000) : maxSize(size) {}
+        explicit VolatileHistoryStorage(std::size_t size = 1000, HistoryDuplicates _duplicates = HistoryDuplicates::keep) :
+            maxSize(size),
+            duplicates(_duplicates)
+        {}
         void Store(const std::vector<std::string>& cmds) override
         {
-            using dt = std::deque<std::string>::difference_type;
-            commands.insert(commands.end(), cmds.begin(), cmds.end());
-            if (commands.size() > maxSize)
-                commands.erase(
-                    commands.begin(),
-                    commands.begin()+static_cast<dt>(commands.size()-maxSize)
-                );
+            for (const auto& c: cmds)
+                Insert(c);
+            while (commands.size() > maxSize)
+                Erase(commands.begin());
         }
         std::vector<std::string> Commands() const override
         {
@@ -56,11 +58,42 @@ class VolatileHistoryStorage : public HistoryStorage
         }
         void Clear() override
         {
+            index.clear();
             commands.clear();
         }
     private:
+        using CmdList = std::list<std::string>;
+
+        void Insert(const std::string& cmd)
+        {
+            if (duplicates == HistoryDuplicates::keep)
+            {
+                commands.push_back(cmd);
+                return;
+            }
+            auto i = index.find(std::cref(cmd));
+            if (i != index.end())
+                Erase(i->second);
+            commands.push_back(cmd);
+            index.emplace(std::cref(commands.back()), std::prev(commands.end()));
+        }
+
+        void Erase(CmdList::iterator i)
+        {
+            if (duplicates == HistoryDuplicates::eraseOlder)
+                index.erase(std::cref(*i));
+            commands.erase(i);
+        }
+
+        // the index keys refer to the strings in the list, to avoid a copy of each command
+        using Key = std::reference_wrapper<const std::string>;
+        struct KeyHash { std::size_t operator()(Key k) const { return std::hash<std::string>()(k.get()); } };
+        struct KeyEqual { bool operator()(Key a, Key b) const { return a.get() == b.get(); } };
+
         const std::size_t maxSize;
-        std::deque<std::string> commands;
+        const HistoryDuplicates duplicates;
+        CmdList commands;
+        std::unordered_map<Key, CmdList::iterator, KeyHash, KeyEqual> index; // used only with HistoryDuplicates::eraseOlder
 };
 
 } // namespace cli
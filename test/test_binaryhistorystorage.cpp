@@ -0,0 +1,214 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <cstdio>
+#include "cli/binaryhistorystorage.h"
+
+using namespace cli;
+
+BOOST_AUTO_TEST_SUITE(BinaryHistoryStorageSuite)
+
+BOOST_AUTO_TEST_CASE(Basics)
+{
+    BinaryHistoryStorage s("cli_test_binhistory", 10);
+    s.Clear(); // in case the test runs multiple times
+
+    // starts empty
+    BOOST_CHECK(s.Commands().empty());
+
+    const std::vector<std::string> v = { "item1", "item2", "item3", "item4", "item5", "item6" };
+    s.Store(v);
+    auto result = s.Commands();
+    BOOST_CHECK_EQUAL_COLLECTIONS(v.begin(), v.end(), result.begin(), result.end());
+
+    const std::vector<std::string> v2 = { "itemA", "itemB", "itemC", "itemD", "itemE", "itemF" };
+    s.Store(v2);
+    result = s.Commands();
+    const std::vector<std::string> expected = { "item3", "item4", "item5", "item6", "itemA", "itemB", "itemC", "itemD", "itemE", "itemF" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+
+    // another object, same file => same result
+    BinaryHistoryStorage s2("cli_test_binhistory", 10);
+    result = s2.Commands();
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+
+    // many commands: the file is compacted
+    for (int i = 0; i < 100; ++i)
+        s2.Store({ "cmd" + std::to_string(i) });
+    result = s2.Commands();
+    BOOST_REQUIRE_EQUAL(result.size(), 10u);
+    BOOST_CHECK_EQUAL(result.front(), "cmd90");
+    BOOST_CHECK_EQUAL(result.back(), "cmd99");
+    BOOST_CHECK(s2.Records(1000).size() <= 20u); // at most twice the size
+
+    s2.Clear();
+    BOOST_CHECK(s2.Commands().empty()); // check clear
+}
+
+BOOST_AUTO_TEST_CASE(RecordContent)
+{
+    BinaryHistoryStorage s("cli_test_binhistory", 10, "user1");
+    s.Clear();
+
+    const auto before = std::chrono::system_clock::now();
+    const std::vector<std::string> v = { "multi\nline", std::string("with\0zero", 9), "" };
+    s.Store(v);
+    auto result = s.Commands();
+    BOOST_CHECK_EQUAL_COLLECTIONS(v.begin(), v.end(), result.begin(), result.end());
+
+    auto records = s.Records(2);
+    BOOST_REQUIRE_EQUAL(records.size(), 2u);
+    BOOST_CHECK_EQUAL(records[0].command, v[1]);
+    BOOST_CHECK_EQUAL(records[1].command, v[2]);
+    BOOST_CHECK_EQUAL(records[1].tag, "user1");
+    BOOST_CHECK(records[1].time >= std::chrono::time_point_cast<std::chrono::milliseconds>(before));
+    BOOST_CHECK(records[1].time <= std::chrono::system_clock::now());
+
+    s.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(Corruption)
+{
+    BinaryHistoryStorage s("cli_test_binhistory", 10);
+    s.Clear();
+
+    const std::vector<std::string> v = { "item1", "item2", "item3" };
+    s.Store(v);
+
+    // simulate a partial write
+    {
+        std::ofstream f("cli_test_binhistory", std::ios_base::out | std::ios_base::binary | std::ios_base::app);
+        f << "CLIH\x20\x00";
+    }
+
+    auto result = s.Commands();
+    BOOST_CHECK_EQUAL_COLLECTIONS(v.begin(), v.end(), result.begin(), result.end());
+
+    // a new object repairs the file before appending
+    BinaryHistoryStorage s2("cli_test_binhistory", 10);
+    s2.Store({ "item4" });
+    result = s2.Commands();
+    const std::vector<std::string> expected = { "item1", "item2", "item3", "item4" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+
+    s2.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(ZeroTail)
+{
+    const std::vector<std::string> tails = {
+        std::string(8, '\0'), // preallocated space after a crash
+        std::string(64, '\0'),
+        std::string(20, 'x') + std::string(4, '\0') // a record size of 0
+    };
+    for (const auto& tail: tails)
+    {
+        BinaryHistoryStorage s("cli_test_binhistory", 1);
+        s.Clear();
+        s.Store({ "a", "b" });
+
+        {
+            std::ofstream f("cli_test_binhistory", std::ios_base::out | std::ios_base::binary | std::ios_base::app);
+            f.write(tail.data(), static_cast<std::streamsize>(tail.size()));
+        }
+
+        // the last good command is returned, not an empty one
+        auto result = s.Commands();
+        BOOST_REQUIRE_EQUAL(result.size(), 1u);
+        BOOST_CHECK_EQUAL(result[0], "b");
+
+        // a new object repairs the file before appending
+        BinaryHistoryStorage s2("cli_test_binhistory", 2);
+        s2.Store({ "c" });
+        result = s2.Commands();
+        const std::vector<std::string> expected = { "b", "c" };
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+
+        s2.Clear();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MaxCommandSize)
+{
+    BinaryHistoryStorage s("cli_test_binhistory", 10);
+    s.Clear();
+
+    // the payload is at most 16 MiB: time (8 bytes), tag size (2 bytes), empty tag and command
+    const std::size_t maxCommandSize = (1 << 24) - 10;
+    const std::vector<std::string> v = {
+        "item1",
+        std::string(maxCommandSize, 'a'),
+        std::string(maxCommandSize + 1, 'b'), // not stored
+        "item2"
+    };
+    s.Store(v);
+    auto result = s.Commands();
+    BOOST_REQUIRE_EQUAL(result.size(), 3u);
+    BOOST_CHECK_EQUAL(result[0], "item1");
+    BOOST_CHECK(result[1] == v[1]);
+    BOOST_CHECK_EQUAL(result[2], "item2");
+
+    // the file is still readable by a new object
+    BinaryHistoryStorage s2("cli_test_binhistory", 10);
+    s2.Store({ "item3" });
+    result = s2.Commands();
+    BOOST_REQUIRE_EQUAL(result.size(), 4u);
+    BOOST_CHECK_EQUAL(result[2], "item2");
+    BOOST_CHECK_EQUAL(result[3], "item3");
+
+    s2.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(Import)
+{
+    {
+        std::ofstream f("cli_test_history_text");
+        f << "item1\nitem2\nitem3\n";
+    }
+
+    BinaryHistoryStorage s("cli_test_binhistory", 10, "imported");
+    s.Clear();
+    BOOST_CHECK(s.ImportTextFile("cli_test_history_text"));
+    BOOST_CHECK(!s.ImportTextFile("cli_test_not_existing_file"));
+
+    auto result = s.Commands();
+    const std::vector<std::string> expected = { "item1", "item2", "item3" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+    auto records = s.Records(1);
+    BOOST_REQUIRE_EQUAL(records.size(), 1u);
+    BOOST_CHECK(records[0].time == std::chrono::system_clock::time_point{});
+    BOOST_CHECK_EQUAL(records[0].tag, "imported");
+
+    s.Clear();
+    std::remove("cli_test_history_text");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include "cli/detail/bufferpool.h"
+
+using namespace cli::detail;
+
+BOOST_AUTO_TEST_SUITE(BufferPoolSuite)
+
+BOOST_AUTO_TEST_CASE(Sizes)
+{
+    auto pool = std::make_shared<BufferPool>(1000, 5000, 4);
+    BOOST_CHECK_EQUAL(pool->MinSize(), 1024u);
+    BOOST_CHECK_EQUAL(pool->MaxSize(), 8192u);
+    BOOST_CHECK_EQUAL(pool->Get(0).Size(), 1024u);
+    BOOST_CHECK_EQUAL(pool->Get(1024).Size(), 1024u);
+    BOOST_CHECK_EQUAL(pool->Get(1025).Size(), 2048u);
+    BOOST_CHECK_EQUAL(pool->Get(5000).Size(), 8192u);
+    BOOST_CHECK_EQUAL(pool->Get(100000).Size(), 8192u);
+    BufferPool::Buffer empty;
+    BOOST_CHECK(!empty);
+    BOOST_CHECK_EQUAL(empty.Size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(Reuse)
+{
+    auto pool = std::make_shared<BufferPool>(1024, 8192, 2);
+    char* first = nullptr;
+    {
+        auto b = pool->Get(2048);
+        BOOST_CHECK(b);
+        first = b.Data();
+        b.Data()[2047] = 'x';
+    }
+    auto stats = pool->Statistics();
+    BOOST_CHECK_EQUAL(stats.allocated, 1u);
+    BOOST_CHECK_EQUAL(stats.free, 1u);
+
+    // a buffer of the same size is reused, one of another size is not
+    auto a = pool->Get(1500);
+    BOOST_CHECK(a.Data() == first);
+    auto b = pool->Get(1024);
+    stats = pool->Statistics();
+    BOOST_CHECK_EQUAL(stats.allocated, 2u);
+    BOOST_CHECK_EQUAL(stats.reused, 1u);
+    BOOST_CHECK_EQUAL(stats.free, 0u);
+
+    // moving a buffer does not release it
+    BufferPool::Buffer c = std::move(a);
+    BOOST_CHECK(!a);
+    BOOST_CHECK_EQUAL(a.Size(), 0u);
+    BOOST_CHECK(c.Data() == first);
+    BOOST_CHECK_EQUAL(pool->Statistics().free, 0u);
+
+    // assigning releases the old buffer
+    c = std::move(b);
+    BOOST_CHECK_EQUAL(pool->Statistics().free, 1u);
+    BOOST_CHECK_EQUAL(c.Size(), 1024u);
+}
+
+BOOST_AUTO_TEST_CASE(MaxFree)
+{
+    auto pool = std::make_shared<BufferPool>(1024, 1024, 2);
+    {
+        std::vector<BufferPool::Buffer> buffers;
+        for (int i = 0; i < 5; ++i)
+            buffers.push_back(pool->Get(1024));
+    }
+    BOOST_CHECK_EQUAL(pool->Statistics().allocated, 5u);
+    BOOST_CHECK_EQUAL(pool->Statistics().free, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(OutlivesThePool)
+{
+    // the buffers keep their pool alive
+    BufferPool::Buffer b;
+    {
+        auto pool = std::make_shared<BufferPool>();
+        b = pool->Get(10);
+    }
+    BOOST_CHECK(b);
+    b.Data()[0] = 'x';
+}
+
+BOOST_AUTO_TEST_SUITE_END()
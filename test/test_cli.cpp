@@ -30,6 +30,10 @@
 #include <boost/test/unit_test.hpp>
 #include "cli/cli.h"
 #include "cli/clifilesession.h"
+#include "cli/partitionedhistorystorage.h"
+#include "cli/loopscheduler.h"
+#include <thread>
+#include <set>
 
 using namespace std;
 using namespace cli;
@@ -87,6 +91,17 @@ void UserInput(Cli& cli, stringstream& oss, const string& input)
     session.Start();
 }
 
+// a session whose output is written in the thread of a scheduler
+class ScheduledSession : public CliSession
+{
+public:
+    ScheduledSession(Cli& _cli, std::ostream& _out, Scheduler& scheduler) :
+        CliSession(_cli, _out)
+    {
+        OutputScheduler(scheduler);
+    }
+};
+
 } // namespace
 
 BOOST_AUTO_TEST_SUITE(CliSuite)
@@ -410,4 +425,275 @@ BOOST_AUTO_TEST_CASE(Exceptions)
     BOOST_CHECK_NO_THROW( UserInput(cli, oss, "customexception") );
 }
 
+BOOST_AUTO_TEST_CASE(SharedHistory)
+{
+    auto rootMenu = make_unique<Menu>("cli");
+    rootMenu->Insert("cmd", [](ostream&, int){} );
+
+    Cli cli(move(rootMenu));
+
+    stringstream oss1;
+    stringstream oss2;
+    CliSession session1(cli, oss1);
+    CliSession session2(cli, oss2);
+
+    session1.Feed("cmd 1");
+    session2.Feed("cmd 2");
+    session1.Feed("cmd 3");
+
+    // each session sees the commands of the other one without reconnecting
+    BOOST_CHECK_EQUAL(session2.PreviousCmd(""), "cmd 3");
+    BOOST_CHECK_EQUAL(session2.PreviousCmd("cmd 3"), "cmd 1");
+    BOOST_CHECK_EQUAL(session2.PreviousCmd("cmd 1"), "cmd 2");
+
+    BOOST_CHECK_EQUAL(session1.PreviousCmd(""), "cmd 2");
+    BOOST_CHECK_EQUAL(session1.PreviousCmd("cmd 2"), "cmd 3");
+    BOOST_CHECK_EQUAL(session1.PreviousCmd("cmd 3"), "cmd 1");
+}
+
+BOOST_AUTO_TEST_CASE(SessionIdentity)
+{
+    auto rootMenu = make_unique<Menu>("cli");
+    rootMenu->Insert("cmd", [](ostream&, int){} );
+
+    Cli cli(move(rootMenu), make_unique<PartitionedHistoryStorage>());
+
+    stringstream oss;
+    {
+        CliSession session1(cli, oss, 100, "user1");
+        CliSession session2(cli, oss, 100, "user2");
+        session1.Feed("cmd 1");
+        session2.Feed("cmd 2");
+        session1.Exit();
+        session2.Exit();
+    }
+
+    // a new session loads only the commands of its own identity
+    CliSession session(cli, oss, 100, "user1");
+    BOOST_CHECK_EQUAL(session.Identity(), "user1");
+    BOOST_CHECK_EQUAL(session.PreviousCmd(""), "cmd 1");
+    BOOST_CHECK_EQUAL(session.PreviousCmd("cmd 1"), "cmd 1");
+}
+
+// a storage written before the identities: it overrides only the original methods
+class LegacyHistoryStorage : public HistoryStorage
+{
+public:
+    void Store(const vector<string>& cmds) override { commands.insert(commands.end(), cmds.begin(), cmds.end()); }
+    vector<string> Commands() const override { return commands; }
+    void Clear() override { commands.clear(); }
+private:
+    vector<string> commands;
+};
+
+BOOST_AUTO_TEST_CASE(SessionIdentityLegacyStorage)
+{
+    auto rootMenu = make_unique<Menu>("cli");
+    rootMenu->Insert("cmd", [](ostream&, int){} );
+
+    Cli cli(move(rootMenu), make_unique<LegacyHistoryStorage>());
+
+    stringstream oss;
+    {
+        CliSession session1(cli, oss, 100, "user1");
+        CliSession session2(cli, oss);
+        session1.Feed("cmd 1");
+        session2.Feed("cmd 2");
+        session1.Exit();
+        session2.Exit();
+    }
+
+    // the storage ignores the identity: a new session loads all the commands
+    CliSession session(cli, oss, 100, "user1");
+    BOOST_CHECK_EQUAL(session.PreviousCmd(""), "cmd 2");
+    BOOST_CHECK_EQUAL(session.PreviousCmd("cmd 2"), "cmd 1");
+}
+
+BOOST_AUTO_TEST_CASE(AutoSuggestions)
+{
+    auto rootMenu = make_unique<Menu>("cli");
+    rootMenu->Insert("cmd", [](ostream&, int){} );
+
+    Cli cli(move(rootMenu));
+
+    stringstream oss;
+    {
+        CliSession session(cli, oss);
+        BOOST_CHECK(!session.AutoSuggestions());
+        session.Feed("cmd 1");
+        BOOST_CHECK_EQUAL(session.Suggestion("c"), "");
+        session.Exit();
+    }
+
+    cli.AutoSuggestions(true);
+    CliSession session(cli, oss);
+    BOOST_CHECK(session.AutoSuggestions());
+    BOOST_CHECK_EQUAL(session.Suggestion("c"), "cmd 1"); // from the history storage
+    session.Feed("cmd 2");
+    BOOST_CHECK_EQUAL(session.Suggestion("c"), "cmd 2");
+    BOOST_CHECK_EQUAL(session.Suggestion("cmd 1"), "");
+}
+
+BOOST_AUTO_TEST_CASE(SharedSuggestions)
+{
+    auto rootMenu = make_unique<Menu>("cli");
+    rootMenu->Insert("cmd", [](ostream&, int){} );
+
+    Cli cli(move(rootMenu), make_unique<PartitionedHistoryStorage>());
+    cli.AutoSuggestions(true);
+
+    stringstream oss;
+    CliSession session1(cli, oss, 100, "user1");
+    CliSession session2(cli, oss, 100, "user1");
+    CliSession session3(cli, oss, 100, "user2");
+    session1.Feed("cmd 1");
+    BOOST_CHECK_EQUAL(session2.Suggestion("c"), "cmd 1"); // the same index
+    session2.Feed("cmd 2");
+    BOOST_CHECK_EQUAL(session1.Suggestion("c"), "cmd 2");
+    BOOST_CHECK_EQUAL(session3.Suggestion("c"), ""); // another identity
+
+    // a new session of the identity uses the index of the others
+    CliSession session4(cli, oss, 100, "user1");
+    session1.Feed("cmd 3");
+    BOOST_CHECK_EQUAL(session4.Suggestion("c"), "cmd 3");
+}
+
+BOOST_AUTO_TEST_CASE(GlobalOutStream)
+{
+    Cli cli(make_unique<Menu>("cli"));
+
+    stringstream oss1;
+    stringstream oss2;
+    CliSession session1(cli, oss1);
+    CliSession session2(cli, oss2);
+    oss1.str("");
+    oss2.str("");
+
+    // the output is broadcast one line at a time
+    Cli::cout() << "hello" << ' ' << "world";
+    BOOST_CHECK_EQUAL(oss1.str(), "");
+    Cli::cout() << '\n' << "partial";
+    BOOST_CHECK_EQUAL(oss1.str(), "hello world\n");
+    BOOST_CHECK_EQUAL(oss2.str(), "hello world\n");
+    // ... or when the stream is flushed
+    Cli::cout() << std::flush;
+    BOOST_CHECK_EQUAL(oss1.str(), "hello world\npartial");
+    BOOST_CHECK_EQUAL(oss2.str(), "hello world\npartial");
+
+    session2.Exit();
+    Cli::cout() << "line 1\nline 2" << std::endl;
+    BOOST_CHECK_EQUAL(oss1.str(), "hello world\npartialline 1\nline 2\n");
+}
+
+BOOST_AUTO_TEST_CASE(GlobalOutStreamThreads)
+{
+    Cli cli(make_unique<Menu>("cli"));
+
+    stringstream oss;
+    CliSession session(cli, oss);
+    oss.str("");
+
+    constexpr int threads = 8;
+    constexpr int lines = 200;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t)
+        producers.emplace_back([t](){
+            for (int l = 0; l < lines; ++l)
+                Cli::cout() << "thread " << t << " line " << l << '\n';
+        });
+    // sessions coming and going while the producers are running
+    for (int i = 0; i < 100; ++i)
+    {
+        stringstream other;
+        CliSession s(cli, other);
+    }
+    for (auto& p: producers)
+        p.join();
+
+    // no line is lost or torn
+    std::set<string> result;
+    string line;
+    while (getline(oss, line))
+        result.insert(line);
+    BOOST_CHECK_EQUAL(result.size(), static_cast<std::size_t>(threads * lines));
+    BOOST_CHECK(result.count("thread 3 line 100") == 1);
+}
+
+BOOST_AUTO_TEST_CASE(GlobalOutStreamScheduler)
+{
+    Cli cli(make_unique<Menu>("cli"));
+    LoopScheduler scheduler;
+    stringstream oss;
+    ScheduledSession session(cli, oss, scheduler);
+    while (scheduler.PollOne()) {}
+    oss.str("");
+
+    std::thread producer([](){ Cli::cout() << "from a worker" << std::endl; });
+    producer.join();
+    // the line is written by the scheduler
+    BOOST_CHECK_EQUAL(oss.str(), "");
+    while (scheduler.PollOne()) {}
+    BOOST_CHECK_EQUAL(oss.str(), "from a worker\n");
+
+    // in the thread of the scheduler, the output is written right away
+    Cli::cout() << "from the scheduler" << std::endl;
+    BOOST_CHECK_EQUAL(oss.str(), "from a worker\nfrom the scheduler\n");
+}
+
+BOOST_AUTO_TEST_CASE(Pager)
+{
+    auto calls = std::make_shared<int>(0);
+    auto lines = [calls](std::ostream& o){ o << "line " << (*calls)++ << '\n'; return *calls < 100; };
+
+    auto rootMenu = make_unique<Menu>("cli");
+    rootMenu->Insert("dump", [lines](ostream& out){ Paginate(out, lines); } );
+    Cli cli(move(rootMenu));
+
+    stringstream oss;
+    CliSession session(cli, oss);
+
+    // without the pager, the whole output is written
+    oss.str("");
+    session.Feed("dump");
+    BOOST_CHECK(!session.Paging());
+    BOOST_CHECK_EQUAL(*calls, 100);
+    BOOST_CHECK(oss.str().find("line 99\n") != string::npos);
+
+    // with the pager, one screen at a time
+    *calls = 0;
+    session.Pager(11);
+    oss.str("");
+    session.Feed("dump");
+    BOOST_CHECK(session.Paging());
+    BOOST_CHECK_EQUAL(*calls, 10);
+    BOOST_CHECK(oss.str().find("line 9\n") != string::npos);
+    BOOST_CHECK(oss.str().find("line 10\n") == string::npos);
+
+    session.PagerShow(1);
+    BOOST_CHECK_EQUAL(*calls, 11);
+    session.PagerNextPage();
+    BOOST_CHECK_EQUAL(*calls, 21);
+
+    // search
+    oss.str("");
+    session.PagerSearch("line 42");
+    BOOST_CHECK_EQUAL(oss.str().substr(0, 20), "...skipping\nline 42\n");
+    BOOST_CHECK_EQUAL(*calls, 51); // a page, with the "...skipping" line
+    BOOST_CHECK(session.Paging());
+
+    // no more calls after the user quits
+    session.PagerStop();
+    BOOST_CHECK(!session.Paging());
+    session.Prompt();
+    BOOST_CHECK_EQUAL(*calls, 51);
+
+    // end of the output
+    *calls = 0;
+    session.Feed("dump");
+    session.PagerSearch("not there");
+    BOOST_CHECK(!session.Paging());
+    BOOST_CHECK_EQUAL(*calls, 100);
+    BOOST_CHECK(oss.str().find("Pattern not found") != string::npos);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
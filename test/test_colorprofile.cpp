@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include "cli/cli.h"
+
+using namespace std;
+using namespace cli;
+using namespace cli::detail;
+
+namespace
+{
+
+// the output of the manipulators, to compare with the cached strings
+template <typename M>
+string Manipulated(ostream& os, M m)
+{
+    ostringstream oss;
+    oss.iword(rang::rang_implementation::getIword()) = os.iword(rang::rang_implementation::getIword());
+    oss << m;
+    os.iword(rang::rang_implementation::getIword()) = oss.iword(rang::rang_implementation::getIword());
+    return oss.str();
+}
+
+void CheckSameOutput(ostream& os, const ColorStrings& c)
+{
+    BOOST_CHECK_EQUAL(c.beforePrompt, Manipulated(os, beforePrompt));
+    BOOST_CHECK_EQUAL(c.afterPrompt, Manipulated(os, afterPrompt));
+    BOOST_CHECK_EQUAL(c.beforeInput, Manipulated(os, beforeInput));
+    BOOST_CHECK_EQUAL(c.afterInput, Manipulated(os, afterInput));
+    BOOST_CHECK_EQUAL(c.beforeSuggestion, Manipulated(os, beforeSuggestion));
+    BOOST_CHECK_EQUAL(c.afterSuggestion, Manipulated(os, afterSuggestion));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ColorProfileSuite)
+
+BOOST_AUTO_TEST_CASE(CachedStrings)
+{
+    ostringstream out;
+    ColorCache cache(out);
+
+    SetNoColor();
+    CheckSameOutput(out, cache.Get());
+    BOOST_CHECK(cache.Get().beforePrompt.empty());
+    BOOST_CHECK(cache.Get().afterPrompt.empty());
+    BOOST_CHECK(cache.Get().beforeSuggestion.empty());
+    BOOST_CHECK(cache.Get().afterSuggestion.empty());
+
+    SetColor();
+    CheckSameOutput(out, cache.Get());
+    BOOST_CHECK(!cache.Get().beforePrompt.empty());
+    BOOST_CHECK(!cache.Get().beforeSuggestion.empty());
+
+    // once the colors have been forced on the stream, the resets are always sent
+    SetNoColor();
+    CheckSameOutput(out, cache.Get());
+    BOOST_CHECK(cache.Get().beforePrompt.empty());
+    BOOST_CHECK(!cache.Get().afterPrompt.empty());
+
+    // nothing is written on the stream
+    BOOST_CHECK(out.str().empty());
+}
+
+BOOST_AUTO_TEST_CASE(CachedPrompt)
+{
+    auto rootMenu = make_unique<Menu>("cli");
+    auto subMenu = make_unique<Menu>("sub");
+    rootMenu->Insert(std::move(subMenu));
+    Cli cli(std::move(rootMenu));
+
+    stringstream oss;
+    CliSession session(cli, oss);
+
+    SetNoColor();
+    session.Prompt();
+    BOOST_CHECK_EQUAL(oss.str(), "cli> ");
+
+    oss.str("");
+    session.Feed("sub");
+    session.Prompt();
+    BOOST_CHECK_EQUAL(oss.str(), "sub> ");
+
+    oss.str("");
+    SetColor();
+    session.Prompt();
+    BOOST_CHECK_EQUAL(oss.str(), "\033[32m\033[1msub\033[0m> ");
+
+    oss.str("");
+    SetNoColor();
+    session.Feed("cli");
+    session.Prompt();
+    BOOST_CHECK_EQUAL(oss.str(), "cli\033[0m> ");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
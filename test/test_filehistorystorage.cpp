@@ -83,4 +83,24 @@ BOOST_AUTO_TEST_CASE(Persistence)
     BOOST_CHECK(s2.Commands().empty()); // check clear
 }
 
+BOOST_AUTO_TEST_CASE(EraseOlderDuplicates)
+{
+    FileHistoryStorage s("cli_test_history", 4, HistoryDuplicates::eraseOlder);
+    s.Clear(); // in case the test runs multiple times
+
+    const std::vector<std::string> v = { "item1", "item2", "item1", "item3", "item1" };
+    s.Store(v);
+    auto result = s.Commands();
+    const std::vector<std::string> expected = { "item2", "item3", "item1" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+
+    const std::vector<std::string> v2 = { "item2", "item4", "item5" };
+    s.Store(v2);
+    result = s.Commands();
+    const std::vector<std::string> expected2 = { "item1", "item2", "item4", "item5" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected2.begin(), expected2.end(), result.begin(), result.end());
+
+    s.Clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -0,0 +1,218 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cli/detail/boostasiolib.h"
+#include "cli/detail/genericasioremotecli.h"
+#include "cli/loopscheduler.h"
+
+// The global operator new of this program keeps the count of the bytes
+// allocated and not yet released, to check the memory used by the sessions
+// (it's a separate executable, so that the other tests don't use it).
+
+namespace
+{
+
+std::atomic<long long> liveBytes{0};
+
+// the size of the block is stored before the memory returned
+const std::size_t headerSize = alignof(std::max_align_t) > sizeof(std::size_t) ? alignof(std::max_align_t) : sizeof(std::size_t);
+
+void* Allocate(std::size_t size) noexcept
+{
+    auto block = static_cast<char*>(std::malloc(size + headerSize));
+    if (block == nullptr)
+        return nullptr;
+    *reinterpret_cast<std::size_t*>(block) = size;
+    liveBytes += static_cast<long long>(size);
+    return block + headerSize;
+}
+
+void Release(void* p) noexcept
+{
+    if (p == nullptr)
+        return;
+    auto block = static_cast<char*>(p) - headerSize;
+    liveBytes -= static_cast<long long>(*reinterpret_cast<std::size_t*>(block));
+    std::free(block);
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    if (auto p = Allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void operator delete(void* p) noexcept { Release(p); }
+void operator delete[](void* p) noexcept { Release(p); }
+void operator delete(void* p, std::size_t) noexcept { Release(p); }
+void operator delete[](void* p, std::size_t) noexcept { Release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { Release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { Release(p); }
+
+using namespace cli;
+using namespace cli::detail;
+
+namespace
+{
+
+std::unique_ptr<Menu> MonitoringMenu()
+{
+    auto root = std::make_unique<Menu>("monitor");
+    root->Insert("status", [](std::ostream& out){ out << "ok\n"; }, "Show the status");
+    root->Insert("load", [](std::ostream& out, int minutes){ out << minutes << '\n'; }, "Show the load average");
+    return root;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(FootprintSuite)
+
+// A session that has not run any command yet, with a history
+// of 100 commands already stored by the sessions that exited
+BOOST_AUTO_TEST_CASE(IdleSession)
+{
+    Cli cli(MonitoringMenu());
+    {
+        std::ostringstream out;
+        CliSession session(cli, out);
+        for (int i = 0; i < 100; ++i)
+            session.Feed("load " + std::to_string(i));
+        session.Exit();
+    }
+
+    const std::size_t sessions = 1000;
+    std::vector<std::ostringstream> streams(sessions);
+    std::vector<std::unique_ptr<CliSession>> v;
+    v.reserve(sessions);
+    const auto before = liveBytes.load();
+    for (auto& s: streams)
+        v.push_back(std::make_unique<CliSession>(cli, s));
+    const auto perSession = (liveBytes.load() - before) / static_cast<long long>(sessions);
+    BOOST_TEST_MESSAGE("bytes per idle session: " << perSession);
+    BOOST_CHECK_LE(perSession, 1536);
+
+    // the history is loaded when the user needs it
+    BOOST_CHECK_EQUAL(v[1]->PreviousCmd(""), "load 99");
+    auto& session = *v.front();
+    session.Feed("status");
+    BOOST_CHECK_EQUAL(session.PreviousCmd(""), "status");
+    BOOST_CHECK_EQUAL(session.PreviousCmd("status"), "load 99");
+}
+
+// A telnet session waiting for the input of the user, after the first prompt
+BOOST_AUTO_TEST_CASE(IdleTelnetSession)
+{
+    Cli cli(MonitoringMenu());
+    LoopScheduler scheduler;
+    BoostAsioLib::ContextType ioc;
+    asiolib::ip::tcp::acceptor acceptor(ioc, asiolib::ip::tcp::endpoint(asiolib::ip::address_v4::loopback(), 0));
+
+    const std::size_t sessions = 100;
+    std::vector<std::unique_ptr<asiolib::ip::tcp::socket>> clients;
+    std::vector<std::unique_ptr<asiolib::ip::tcp::socket>> sockets;
+    for (std::size_t i = 0; i < sessions; ++i)
+    {
+        clients.push_back(std::make_unique<asiolib::ip::tcp::socket>(ioc));
+        clients.back()->connect(acceptor.local_endpoint());
+        sockets.push_back(std::make_unique<asiolib::ip::tcp::socket>(ioc));
+        acceptor.accept(*sockets.back());
+    }
+    // runs the handlers until the prompts have been sent
+    char data[1024];
+    auto drain = [&]()
+    {
+        for (int idle = 0; idle < 5; )
+        {
+            bool busy = ioc.poll() != 0;
+            while (scheduler.PollOne())
+                busy = true;
+            for (auto& c: clients)
+                while (c->is_open() && c->available() != 0)
+                {
+                    c->read_some(asiolib::buffer(data));
+                    busy = true;
+                }
+            if (busy)
+                idle = 0;
+            else
+            {
+                ++idle;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    };
+
+    std::vector<std::shared_ptr<CliTelnetSession>> v;
+    v.reserve(sessions);
+    const auto before = liveBytes.load();
+    for (auto& s: sockets)
+    {
+        v.push_back(std::make_shared<CliTelnetSession>(scheduler, std::move(*s), cli, [](std::ostream&){}, 100));
+        v.back()->Start();
+    }
+    drain();
+    const auto perSession = (liveBytes.load() - before) / static_cast<long long>(sessions);
+    BOOST_TEST_MESSAGE("bytes per idle telnet session: " << perSession);
+    BOOST_CHECK_LE(perSession, 4096);
+
+    // the sessions still work
+    asiolib::write(*clients.front(), asiolib::buffer(std::string("status\r\n")));
+    std::string output;
+    for (int i = 0; i < 1000 && output.find("ok") == std::string::npos; ++i)
+    {
+        ioc.poll();
+        while (scheduler.PollOne()) {}
+        while (clients.front()->available() != 0)
+            output.append(data, clients.front()->read_some(asiolib::buffer(data)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    BOOST_CHECK(output.find("ok") != std::string::npos);
+
+    for (auto& c: clients)
+        c->close();
+    drain();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -204,4 +204,91 @@ BOOST_AUTO_TEST_CASE(Copies)
     BOOST_CHECK_EQUAL_COLLECTIONS(cmds2.begin(), cmds2.end(), expected2.begin(), expected2.end());
 }
 
+BOOST_AUTO_TEST_CASE(Merge)
+{
+    History history(10);
+
+    history.NewCommand("item1");
+    history.Merge("remote1");
+    history.NewCommand("item2");
+    history.Merge("remote2");
+    history.Merge("remote2"); // repeated
+
+    BOOST_CHECK_EQUAL(history.Previous(""), "remote2");
+    BOOST_CHECK(history.Browsing());
+    BOOST_CHECK_EQUAL(history.Previous("remote2"), "item2");
+    BOOST_CHECK_EQUAL(history.Previous("item2"), "remote1");
+    BOOST_CHECK_EQUAL(history.Previous("remote1"), "item1");
+    BOOST_CHECK_EQUAL(history.Next(), "remote1");
+
+    // the remote commands are not returned
+    auto cmds = history.GetCommands();
+    const std::vector<std::string> expected = { "item1", "item2" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(cmds.begin(), cmds.end(), expected.begin(), expected.end());
+
+    history.NewCommand("item3");
+    BOOST_CHECK(!history.Browsing());
+}
+
+BOOST_AUTO_TEST_CASE(MergeMoreThanSize)
+{
+    History history(3);
+
+    history.NewCommand("item1");
+    history.NewCommand("item2");
+    for (int i = 0; i < 10; ++i)
+        history.Merge("remote" + std::to_string(i));
+
+    // the commands issued are still stored
+    auto cmds = history.GetCommands();
+    std::vector<std::string> expected = { "item1", "item2" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(cmds.begin(), cmds.end(), expected.begin(), expected.end());
+    // the line being edited takes the place of the remote command
+    BOOST_CHECK_EQUAL(history.Previous(""), "item2");
+    BOOST_CHECK_EQUAL(history.Previous("item2"), "item1");
+
+    // with a buffer full of commands issued, the remote ones are not merged
+    history.NewCommand("item3");
+    history.Merge("remote10");
+    cmds = history.GetCommands();
+    expected = { "item1", "item2", "item3" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(cmds.begin(), cmds.end(), expected.begin(), expected.end());
+
+    // the commands issued still evict the oldest ones
+    history.NewCommand("item4");
+    cmds = history.GetCommands();
+    expected = { "item2", "item3", "item4" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(cmds.begin(), cmds.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(EraseOlderDuplicates)
+{
+    History history(10, HistoryDuplicates::eraseOlder);
+
+    history.NewCommand("item1");
+    history.NewCommand("item2");
+    history.NewCommand("item1");
+    history.NewCommand("item3");
+    history.Merge("item2");
+    history.NewCommand("item3");
+
+    BOOST_CHECK_EQUAL(history.Previous(""), "item3");
+    BOOST_CHECK_EQUAL(history.Previous("item3"), "item2");
+    BOOST_CHECK_EQUAL(history.Previous("item2"), "item1");
+    BOOST_CHECK_EQUAL(history.Previous("item1"), "item1");
+
+    // issuing again a command while browsing
+    history.NewCommand("item1");
+
+    BOOST_CHECK_EQUAL(history.Previous(""), "item1");
+    BOOST_CHECK_EQUAL(history.Previous("item1"), "item3");
+    BOOST_CHECK_EQUAL(history.Previous("item3"), "item2");
+    BOOST_CHECK_EQUAL(history.Previous("item2"), "item2");
+
+    // item2 is still stored, although its newest occurrence has been merged
+    auto cmds = history.GetCommands();
+    const std::vector<std::string> expected = { "item2", "item3", "item1" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(cmds.begin(), cmds.end(), expected.begin(), expected.end());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
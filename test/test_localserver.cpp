@@ -0,0 +1,280 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cli/detail/boostasiolib.h"
+#include "cli/detail/genericasioremotecli.h"
+
+#ifdef CLI_DETAIL_LOCAL_SOCKETS
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cli;
+using namespace cli::detail;
+
+namespace
+{
+
+std::string SocketPath(const std::string& name)
+{
+    return "/tmp/cli_test_" + name + "_" + std::to_string(::getpid());
+}
+
+// a client of the machine protocol on a unix domain socket
+struct LocalClient
+{
+    explicit LocalClient(const std::string& path) : socket(ioc)
+    {
+        socket.connect(asiolib::local::stream_protocol::endpoint(path));
+    }
+    // sends a request and returns the response (header and output)
+    std::string Request(const std::string& request)
+    {
+        asiolib::write(socket, asiolib::buffer(request));
+        return Receive();
+    }
+    std::string Receive()
+    {
+        asiolibec::error_code ec;
+        asiolib::read_until(socket, input, '\n', ec);
+        if (ec)
+            return {};
+        std::istream is(&input);
+        std::string header;
+        std::getline(is, header);
+        const auto length = std::stoul(header.substr(header.rfind(' ') + 1));
+        if (input.size() < length)
+            asiolib::read(socket, input, asiolib::transfer_exactly(length - input.size()), ec);
+        std::string output(length, '\0');
+        is.read(&output[0], static_cast<std::streamsize>(length));
+        return header + '\n' + output;
+    }
+    bool Closed()
+    {
+        char c;
+        asiolibec::error_code ec;
+        socket.read_some(asiolib::buffer(&c, 1), ec);
+        return ec == asiolib::error::eof;
+    }
+    BoostAsioLib::ContextType ioc;
+    asiolib::local::stream_protocol::socket socket;
+    asiolib::streambuf input;
+};
+
+// a cli with a local server, running in its own thread
+struct Fixture
+{
+    explicit Fixture(const std::string& path, unsigned permissions = 0600) :
+        cli(Root()),
+        server(cli, scheduler, path, permissions)
+    {}
+    ~Fixture()
+    {
+        Stop();
+    }
+    void Run()
+    {
+        thread = std::thread([this](){ scheduler.Run(); });
+    }
+    void Stop()
+    {
+        if (!thread.joinable())
+            return;
+        scheduler.Stop();
+        thread.join();
+    }
+    static std::unique_ptr<Menu> Root()
+    {
+        auto root = std::make_unique<Menu>("cli");
+        root->Insert("echo", [](std::ostream& out, const std::string& arg){ out << arg << '\n'; });
+        root->Insert("whoami", [](std::ostream& out){ out << "someone\n"; });
+        return root;
+    }
+    Cli cli;
+    GenericAsioScheduler<BoostAsioLib> scheduler;
+    CliGenericLocalServer<BoostAsioLib> server;
+    std::thread thread;
+};
+
+// strips the time from a response header
+std::string WithoutTime(const std::string& response)
+{
+    const auto first = response.find(' ', response.find(' ') + 1);
+    const auto second = response.find(' ', first + 1);
+    return response.substr(0, first) + response.substr(second);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(LocalServerSuite)
+
+BOOST_AUTO_TEST_CASE(Requests)
+{
+    const auto path = SocketPath("requests");
+    Fixture f(path);
+    f.Run();
+    LocalClient client(path);
+    BOOST_CHECK_EQUAL(WithoutTime(client.Request("1 echo hello\n")), "1 ok 6\nhello\n");
+    BOOST_CHECK_EQUAL(WithoutTime(client.Request("2 foo\n")), "2 wrong-command 19\nwrong command: foo\n");
+    BOOST_CHECK_EQUAL(WithoutTime(client.Request("3 exit\n")), "3 ok 0\n");
+    BOOST_CHECK(client.Closed());
+    const auto stats = f.server.Stats();
+    BOOST_CHECK_EQUAL(stats.accepted, 1u);
+    BOOST_CHECK_EQUAL(stats.rejected, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(SocketFile)
+{
+    const auto path = SocketPath("file");
+    {
+        // a socket left by a previous run is replaced
+        Fixture stale(path);
+    }
+    {
+        BoostAsioLib::ContextType ioc;
+        asiolib::local::stream_protocol::acceptor leftover(ioc, asiolib::local::stream_protocol::endpoint(path));
+    }
+    struct stat info;
+    BOOST_REQUIRE(::stat(path.c_str(), &info) == 0);
+    {
+        Fixture f(path, 0660);
+        BOOST_REQUIRE(::stat(path.c_str(), &info) == 0);
+        BOOST_CHECK(S_ISSOCK(info.st_mode));
+        BOOST_CHECK_EQUAL(info.st_mode & 0777, 0660u);
+        BOOST_CHECK_EQUAL(f.server.Path(), path);
+    }
+    // removed with the server
+    BOOST_CHECK(::stat(path.c_str(), &info) != 0);
+}
+
+BOOST_AUTO_TEST_CASE(PeerCredentialsCheck)
+{
+    const auto path = SocketPath("peers");
+    Fixture f(path);
+    std::mutex mutex;
+    std::vector<PeerCredentials> seen;
+    std::atomic<long> allowedUid{-2}; // no one, at first
+    f.server.Peers([&](const PeerCredentials& peer)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen.push_back(peer);
+            return peer.uid == allowedUid;
+        });
+    f.server.SessionIdentity([](const PeerCredentials& peer){ return "uid" + std::to_string(peer.uid); });
+    f.Run();
+    {
+        LocalClient client(path);
+        BOOST_CHECK(client.Closed());
+    }
+    PeerCredentials peer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        BOOST_REQUIRE_EQUAL(seen.size(), 1u);
+        peer = seen.front();
+    }
+#ifdef SO_PEERCRED
+    BOOST_CHECK(peer.known);
+    BOOST_CHECK_EQUAL(peer.pid, static_cast<long>(::getpid()));
+#endif
+    if (!peer.known)
+        return;
+    BOOST_CHECK_EQUAL(peer.uid, static_cast<long>(::getuid()));
+    BOOST_CHECK_EQUAL(peer.gid, static_cast<long>(::getgid()));
+    allowedUid = static_cast<long>(::getuid());
+    LocalClient client(path);
+    BOOST_CHECK_EQUAL(WithoutTime(client.Request("1 echo x\n")), "1 ok 2\nx\n");
+    const auto stats = f.server.Stats();
+    BOOST_CHECK_EQUAL(stats.accepted, 1u);
+    BOOST_CHECK_EQUAL(stats.rejected, 1u);
+    BOOST_CHECK_EQUAL(stats.active, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(AdmissionAndTimeouts)
+{
+    const auto path = SocketPath("limits");
+    Fixture f(path);
+    f.server.Admission(1, "busy\n");
+    f.server.Timeouts(std::chrono::milliseconds(100), std::chrono::milliseconds(0));
+    f.Run();
+    LocalClient first(path);
+    BOOST_CHECK_EQUAL(WithoutTime(first.Request("1 echo a\n")), "1 ok 2\na\n");
+    {
+        LocalClient second(path);
+        asiolib::streambuf b;
+        asiolibec::error_code ec;
+        asiolib::read(second.socket, b, ec);
+        BOOST_CHECK_EQUAL(std::string(asiolib::buffers_begin(b.data()), asiolib::buffers_end(b.data())), "busy\n");
+    }
+    // the first session expires
+    BOOST_CHECK(first.Closed());
+}
+
+// the round trip of a command on the local socket (compared with tcp)
+BOOST_AUTO_TEST_CASE(Latency)
+{
+    const auto path = SocketPath("latency");
+    Fixture f(path);
+    CliGenericMachineServer<BoostAsioLib> tcpServer(f.cli, f.scheduler, "127.0.0.1", 0);
+    f.Run();
+    const int n = 2000;
+    LocalClient local(path);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+        local.Request("1 whoami\n");
+    const auto localTime = std::chrono::steady_clock::now() - start;
+
+    BoostAsioLib::ContextType ioc;
+    asiolib::ip::tcp::socket tcp(ioc);
+    tcp.connect(tcpServer.LocalEndpoint());
+    tcp.set_option(asiolib::ip::tcp::no_delay(true));
+    asiolib::streambuf input;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+    {
+        asiolib::write(tcp, asiolib::buffer(std::string("1 whoami\n")));
+        asiolib::read_until(tcp, input, "someone\n");
+        input.consume(input.size());
+    }
+    const auto tcpTime = std::chrono::steady_clock::now() - start;
+    BOOST_CHECK(localTime.count() > 0 && tcpTime.count() > 0);
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+    BOOST_TEST_MESSAGE("round trip: local " << duration_cast<nanoseconds>(localTime).count() / n / 1000.0
+                       << "us, tcp " << duration_cast<nanoseconds>(tcpTime).count() / n / 1000.0 << "us");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif // CLI_DETAIL_LOCAL_SOCKETS
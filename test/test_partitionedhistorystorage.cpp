@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include "cli/partitionedhistorystorage.h"
+
+using namespace cli;
+
+BOOST_AUTO_TEST_SUITE(PartitionedHistoryStorageSuite)
+
+BOOST_AUTO_TEST_CASE(Basics)
+{
+    PartitionedHistoryStorage s(3);
+    s.Quota("automation", 2);
+
+    // starts empty
+    BOOST_CHECK(s.Commands().empty());
+    BOOST_CHECK(s.CommandsFor("user").empty());
+
+    s.StoreFor("user", { "item1", "item2" });
+    s.StoreFor("automation", { "auto1", "auto2", "auto3", "auto4" });
+    s.Store({ "anonymous" });
+
+    // the partitions don't interfere each other
+    auto result = s.CommandsFor("user");
+    const std::vector<std::string> expected = { "item1", "item2" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+
+    result = s.CommandsFor("automation");
+    const std::vector<std::string> expected2 = { "auto3", "auto4" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected2.begin(), expected2.end(), result.begin(), result.end());
+
+    result = s.Commands();
+    const std::vector<std::string> expected3 = { "anonymous" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected3.begin(), expected3.end(), result.begin(), result.end());
+
+    // default quota
+    s.StoreFor("user", { "item3", "item4" });
+    result = s.CommandsFor("user");
+    const std::vector<std::string> expected4 = { "item2", "item3", "item4" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected4.begin(), expected4.end(), result.begin(), result.end());
+
+    s.Clear();
+    BOOST_CHECK(s.Commands().empty());
+    BOOST_CHECK(s.CommandsFor("user").empty());
+    BOOST_CHECK(s.CommandsFor("automation").empty());
+}
+
+BOOST_AUTO_TEST_CASE(Factory)
+{
+    std::vector<std::pair<std::string, std::size_t>> created;
+    PartitionedHistoryStorage s(
+        10,
+        [&created](const std::string& identity, std::size_t quota)
+        {
+            created.emplace_back(identity, quota);
+            return std::make_unique<VolatileHistoryStorage>(quota);
+        }
+    );
+    s.Quota("user2", 5);
+
+    // a partition is created only when it's used
+    BOOST_CHECK(created.empty());
+    s.StoreFor("user1", { "item1" });
+    BOOST_CHECK(s.CommandsFor("user2").empty());
+    s.StoreFor("user1", { "item2" });
+
+    BOOST_REQUIRE_EQUAL(created.size(), 2u);
+    BOOST_CHECK_EQUAL(created[0].first, "user1");
+    BOOST_CHECK_EQUAL(created[0].second, 10u);
+    BOOST_CHECK_EQUAL(created[1].first, "user2");
+    BOOST_CHECK_EQUAL(created[1].second, 5u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,1313 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#ifdef CLI_USE_ZLIB
+#include <zlib.h>
+#endif
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#include "cli/detail/boostasiolib.h"
+#include "cli/detail/server.h"
+#include "cli/detail/genericasioremotecli.h"
+#include "cli/loopscheduler.h"
+
+using namespace cli;
+using namespace cli::detail;
+
+namespace
+{
+
+class TestSession : public Session
+{
+public:
+    explicit TestSession(asiolib::ip::tcp::socket _socket) : Session(std::move(_socket)) {}
+    using Session::Send;
+    using Session::Disconnect;
+    using Session::OutStream;
+    bool disconnected = false;
+private:
+    void OnConnect() override {}
+    void OnDisconnect() override { disconnected = true; }
+    void OnError() override { disconnected = true; }
+    void OnDataReceived(const ReceivedData&) override {}
+};
+
+class TestTelnetSession : public TelnetSession
+{
+public:
+    explicit TestTelnetSession(asiolib::ip::tcp::socket _socket) : TelnetSession(std::move(_socket)) {}
+    using Session::OutStream;
+    using TelnetSession::OnDataReceived;
+    std::string received; // the data, without the telnet commands
+    std::size_t runs = 0; // calls to OutputRun
+    std::string Encoded(const std::string& data) const
+    {
+        std::vector<asiolib::const_buffer> buffers;
+        Encode(data, buffers);
+        std::string result(asiolib::buffer_size(buffers), '\0');
+        asiolib::buffer_copy(asiolib::buffer(&result[0], result.size()), buffers);
+        return result;
+    }
+    void Receive(const std::string& data)
+    {
+        OnDataReceived(ReceivedData(data.data(), data.size()));
+    }
+private:
+    void Output(signed char c) override { received += static_cast<char>(c); }
+    void OutputRun(const char* data, std::size_t size) override
+    {
+        received.append(data, size);
+        ++runs;
+    }
+};
+
+// a session connected to a client socket through the loopback interface
+template <typename S>
+struct BasicConnection
+{
+    explicit BasicConnection(std::function<void(S&)> setup = {}) : client(ioc)
+    {
+        asiolib::ip::tcp::acceptor acceptor(ioc, asiolib::ip::tcp::endpoint(asiolib::ip::address_v4::loopback(), 0));
+        client.connect(acceptor.local_endpoint());
+        asiolib::ip::tcp::socket socket(ioc);
+        acceptor.accept(socket);
+        session = std::make_shared<S>(std::move(socket));
+        if (setup) setup(*session);
+        session->Start();
+    }
+    ~BasicConnection()
+    {
+        asiolibec::error_code ec;
+        client.close(ec);
+        ioc.poll();
+    }
+    // runs the session until the client receives size bytes (or the connection is closed)
+    std::string Receive(std::size_t size)
+    {
+        std::string result;
+        for (int i = 0; i < 1000 && result.size() < size; ++i)
+        {
+            ioc.poll();
+            asiolibec::error_code ec;
+            const auto available = client.available(ec);
+            if (ec) break;
+            if (available == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            std::string chunk(available, '\0');
+            chunk.resize(client.read_some(asiolib::buffer(&chunk[0], chunk.size()), ec));
+            if (ec) break;
+            result += chunk;
+        }
+        return result;
+    }
+    bool ClientClosed()
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            ioc.poll();
+            char buffer[4096];
+            asiolibec::error_code ec;
+            client.non_blocking(true);
+            client.read_some(asiolib::buffer(buffer), ec);
+            if (ec && ec != asiolib::error::would_block && ec != asiolib::error::try_again)
+                return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+    BoostAsioLib::ContextType ioc;
+    asiolib::ip::tcp::socket client;
+    std::shared_ptr<S> session;
+};
+
+using Connection = BasicConnection<TestSession>;
+
+// the threads used by the sessions of a server (and the largest read)
+struct Threads
+{
+    void Add(std::set<std::thread::id>& s)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        s.insert(std::this_thread::get_id());
+    }
+    std::mutex mutex;
+    std::set<std::thread::id> creation;
+    std::set<std::thread::id> io;
+    std::set<std::thread::id> output;
+    std::thread::id main; // of the main context
+    std::size_t largestRead = 0;
+};
+
+// sends back what it receives
+class EchoSession : public Session
+{
+public:
+    EchoSession(asiolib::ip::tcp::socket _socket, Threads& _threads) : Session(std::move(_socket)), threads(_threads) {}
+private:
+    void OnConnect() override {}
+    void OnDisconnect() override {}
+    void OnError() override {}
+    void OnDataReceived(const ReceivedData& received) override
+    {
+        threads.Add(threads.io);
+        {
+            std::lock_guard<std::mutex> lock(threads.mutex);
+            threads.largestRead = std::max(threads.largestRead, received.size());
+        }
+        auto self( shared_from_this() );
+        PostOutput([this, self, data = received.str()](){
+            threads.Add(threads.output);
+            OutStream() << data << std::flush;
+        });
+    }
+    Threads& threads;
+};
+
+class EchoServer : public Server<BoostAsioLib>
+{
+public:
+    EchoServer(BoostAsioLib::ContextType& ios, std::size_t shards, ShardMode mode = ShardMode::io) : Server<BoostAsioLib>(ios, "127.0.0.1", 0, shards, mode) {}
+    std::shared_ptr<Session> CreateSession(asiolib::ip::tcp::socket socket) override
+    {
+        threads.Add(threads.creation);
+        asiolib::socket_base::keep_alive option;
+        socket.get_option(option);
+        keepAlive = option.value();
+        return std::make_shared<EchoSession>(std::move(socket), threads);
+    }
+    Threads threads;
+    std::atomic<bool> keepAlive{false};
+};
+
+// runs an io context in a thread
+struct Runner
+{
+    Runner() : work(std::make_unique<BoostAsioLib::WorkGuard>(BoostAsioLib::MakeWorkGuard(ioc))), thread([this](){ ioc.run(); }) {}
+    ~Runner()
+    {
+        work.reset();
+        thread.join();
+    }
+    BoostAsioLib::ContextType ioc;
+    std::unique_ptr<BoostAsioLib::WorkGuard> work;
+    std::thread thread;
+};
+
+// the throughput measured by Load
+struct Throughput
+{
+    double connections = 0; // per second
+    double roundTrips = 0; // per second
+};
+
+// clientThreads threads, each one with connections clients sending roundTrips messages.
+// The round trips start when all the clients are connected.
+Throughput Load(std::size_t shards, ShardMode mode, std::size_t clientThreads, std::size_t connections, std::size_t roundTrips, Threads& threads)
+{
+    using Clock = std::chrono::steady_clock;
+    Runner runner;
+    EchoServer server(runner.ioc, shards, mode);
+    const auto endpoint = server.LocalEndpoint();
+    std::atomic<std::size_t> errors{0};
+    std::atomic<std::size_t> connected{0};
+    std::atomic<bool> go{false};
+    const auto start = Clock::now();
+    std::vector<std::thread> clients;
+    for (std::size_t t = 0; t < clientThreads; ++t)
+        clients.emplace_back([&, t]()
+        {
+            BoostAsioLib::ContextType ioc;
+            std::vector<std::unique_ptr<asiolib::ip::tcp::socket>> sockets;
+            for (std::size_t i = 0; i < connections; ++i)
+            {
+                sockets.push_back(std::make_unique<asiolib::ip::tcp::socket>(ioc));
+                sockets.back()->connect(endpoint);
+                sockets.back()->set_option(asiolib::ip::tcp::no_delay(true));
+            }
+            ++connected;
+            while (!go)
+                std::this_thread::yield();
+            const std::string msg = "message " + std::to_string(t) + "\n";
+            std::string reply(msg.size(), '\0');
+            for (std::size_t r = 0; r < roundTrips; ++r)
+                for (auto& s: sockets)
+                {
+                    asiolib::write(*s, asiolib::buffer(msg));
+                    asiolib::read(*s, asiolib::buffer(&reply[0], reply.size()));
+                    if (reply != msg) ++errors;
+                }
+        });
+    while (connected != clientThreads)
+        std::this_thread::yield();
+    const auto connectedAt = Clock::now();
+    go = true;
+    for (auto& c: clients)
+        c.join();
+    const auto end = Clock::now();
+    BOOST_CHECK_EQUAL(errors, 0u);
+    std::lock_guard<std::mutex> lock(server.threads.mutex);
+    threads.creation = server.threads.creation;
+    threads.io = server.threads.io;
+    threads.output = server.threads.output;
+    threads.main = runner.thread.get_id();
+
+    using Seconds = std::chrono::duration<double>;
+    const auto total = static_cast<double>(clientThreads * connections);
+    Throughput result;
+    result.connections = total / Seconds(connectedAt - start).count();
+    result.roundTrips = total * roundTrips / Seconds(end - connectedAt).count();
+    return result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ServerSuite)
+
+BOOST_AUTO_TEST_CASE(SendOrder)
+{
+    Connection c;
+    c.session->Send("one ");
+    c.session->Send("two ");
+    c.session->OutStream() << "three" << std::flush;
+    c.session->Send(std::string(100000, 'x'));
+    const auto received = c.Receive(100013);
+    BOOST_CHECK_EQUAL(received.size(), 100013u);
+    BOOST_CHECK_EQUAL(received.substr(0, 13), "one two three");
+}
+
+BOOST_AUTO_TEST_CASE(CoalescedOutput)
+{
+    Connection c;
+    c.session->OutStream() << "hello" << ' ' << "world";
+    // nothing is sent until the end of the current handler
+    BOOST_CHECK_EQUAL(c.Receive(11), "hello world");
+}
+
+BOOST_AUTO_TEST_CASE(DropPolicy)
+{
+    Connection c;
+    c.session->SendQueue(1000, 500, SendOverflowPolicy::drop);
+    c.session->Send(std::string(600, 'a'));
+    c.session->Send(std::string(600, 'b'));
+    // over the high watermark
+    c.session->Send("lost");
+    const auto received = c.Receive(1200);
+    BOOST_CHECK_EQUAL(received, std::string(600, 'a') + std::string(600, 'b'));
+    // the queue has been drained
+    c.session->Send("sent");
+    BOOST_CHECK_EQUAL(c.Receive(4), "sent");
+}
+
+BOOST_AUTO_TEST_CASE(DisconnectPolicy)
+{
+    Connection c;
+    c.session->SendQueue(1000, 500, SendOverflowPolicy::disconnect);
+    c.session->Send(std::string(1200, 'a'));
+    c.session->Send("too much");
+    BOOST_CHECK(c.ClientClosed());
+    BOOST_CHECK(c.session->disconnected);
+}
+
+BOOST_AUTO_TEST_CASE(BlockPolicy)
+{
+    Connection c;
+    c.session->SendQueue(1000, 500, SendOverflowPolicy::block);
+    c.session->Send(std::string(1200, 'a'));
+    std::atomic<bool> sent{false};
+    std::thread producer([&](){ c.session->Send("late"); sent = true; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK(!sent); // the producer waits for the queue to drain
+    const auto received = c.Receive(1204);
+    producer.join();
+    BOOST_CHECK(sent);
+    BOOST_CHECK_EQUAL(received, std::string(1200, 'a') + "late");
+}
+
+BOOST_AUTO_TEST_CASE(BlockPolicyInIoThread)
+{
+    Connection c;
+    c.session->SendQueue(1000, 500, SendOverflowPolicy::block);
+    // the output of the I/O thread cannot wait, and the client reads nothing
+    for (int i = 0; i < 100000 && !c.session->disconnected; ++i)
+    {
+        c.session->Send(std::string(1000, 'a'));
+        c.ioc.poll();
+    }
+    BOOST_CHECK(c.session->disconnected);
+}
+
+BOOST_AUTO_TEST_CASE(GracefulDisconnect)
+{
+    Connection c;
+    c.session->Send(std::string(100000, 'a'));
+    c.session->OutStream() << "bye";
+    c.session->Disconnect();
+    BOOST_CHECK_EQUAL(c.Receive(100003).size(), 100003u);
+    BOOST_CHECK(c.ClientClosed());
+}
+
+BOOST_AUTO_TEST_CASE(SharedOutput)
+{
+    Connection c1;
+    Connection c2;
+    OutputSink& sink1 = *c1.session;
+    OutputSink& sink2 = *c2.session;
+    c1.session->OutStream() << "own ";
+    const auto text = std::make_shared<const std::string>("shared\n");
+    sink1.Deliver(text);
+    sink2.Deliver(text);
+    BOOST_CHECK_EQUAL(c1.Receive(11), "own shared\n");
+    BOOST_CHECK_EQUAL(c2.Receive(7), "shared\n");
+}
+
+BOOST_AUTO_TEST_CASE(BroadcastDropOldest)
+{
+    Connection c;
+    OutputSink& sink = *c.session;
+    c.session->SendQueue(1000, 100, SendOverflowPolicy::block);
+    auto totals = std::make_shared<BroadcastCounters>();
+    c.session->BroadcastLimit(3, 0, totals);
+    // the client is behind
+    c.session->Send(std::string(600, 'a'));
+    for (int i = 0; i < 5; ++i)
+        sink.Deliver(std::make_shared<const std::string>("m" + std::to_string(i) + '\n'));
+    auto stats = c.session->Broadcasts();
+    BOOST_CHECK_EQUAL(stats.queued, 3u);
+    BOOST_CHECK_EQUAL(stats.dropped, 2u);
+    // the own output of the session is not limited
+    c.session->Send("prompt> ");
+
+    const std::string expected = std::string(600, 'a') + "prompt> m2\nm3\nm4\n[2 lines suppressed]\n";
+    BOOST_CHECK_EQUAL(c.Receive(expected.size()), expected);
+    stats = c.session->Broadcasts();
+    BOOST_CHECK_EQUAL(stats.queued, 0u);
+    BOOST_CHECK_EQUAL(stats.sent, 3u);
+    BOOST_CHECK_EQUAL(totals->sent, 3u);
+    BOOST_CHECK_EQUAL(totals->dropped, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(BroadcastRateLimit)
+{
+    Connection c;
+    OutputSink& sink = *c.session;
+    c.session->BroadcastLimit(100, 20);
+    std::string expected;
+    for (int i = 0; i < 25; ++i)
+    {
+        const std::string msg = "m" + std::to_string(i) + '\n';
+        sink.Deliver(std::make_shared<const std::string>(msg));
+        expected += msg;
+    }
+    // a burst of one second is sent right away
+    BOOST_CHECK_GE(c.session->Broadcasts().queued, 4u);
+    BOOST_CHECK_EQUAL(c.Receive(expected.size()), expected);
+    BOOST_CHECK_EQUAL(c.session->Broadcasts().sent, 25u);
+}
+
+BOOST_AUTO_TEST_CASE(ShardedServer)
+{
+    Threads threads;
+    Load(4, ShardMode::io, 4, 8, 5, threads);
+    // the I/O is distributed among the shards, while creation and output stay in the main context
+    const std::set<std::thread::id> main{ threads.main };
+    BOOST_CHECK(threads.io.size() > 1);
+    BOOST_CHECK(threads.creation == main);
+    BOOST_CHECK(threads.output == main);
+    BOOST_CHECK(threads.io.count(threads.main) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ShardedSessions)
+{
+    Threads threads;
+    Load(4, ShardMode::sessions, 4, 8, 5, threads);
+    // only the creation stays in the main context: each session runs in its shard
+    const std::set<std::thread::id> main{ threads.main };
+    BOOST_CHECK(threads.io.size() > 1);
+    BOOST_CHECK(threads.creation == main);
+    BOOST_CHECK(threads.output == threads.io);
+    BOOST_CHECK(threads.io.count(threads.main) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ShardedServerLoad)
+{
+    // The throughput is shown with --log_level=message. No speedup is checked,
+    // because it depends on the cores of the machine running the test.
+    const std::size_t shards = std::max(2u, std::thread::hardware_concurrency());
+    for (auto mode: { ShardMode::io, ShardMode::sessions })
+        for (std::size_t n: { std::size_t(1), shards })
+        {
+            Threads threads;
+            const auto t = Load(n, mode, 8, 8, 100, threads);
+            BOOST_TEST_MESSAGE(
+                (mode == ShardMode::io ? "io" : "sessions") << " mode, " << n << " shards: " <<
+                static_cast<long>(t.connections) << " connections/s, " <<
+                static_cast<long>(t.roundTrips) << " round trips/s"
+            );
+            BOOST_CHECK_GT(t.connections, 0.0);
+            BOOST_CHECK_GT(t.roundTrips, 0.0);
+        }
+}
+
+namespace
+{
+
+// waits until the condition on the stats of server is true
+template <typename P>
+bool WaitStats(const EchoServer& server, P predicate)
+{
+    for (int i = 0; i < 2000; ++i)
+    {
+        if (predicate(server.Stats()))
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+// reads from a client until the connection is closed by the server
+std::string ReadAll(asiolib::ip::tcp::socket& client)
+{
+    std::string result;
+    char buffer[256];
+    asiolibec::error_code ec;
+    while (!ec)
+        result.append(buffer, client.read_some(asiolib::buffer(buffer), ec));
+    return result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(MaxSessions)
+{
+    Runner runner;
+    EchoServer server(runner.ioc, 0);
+    server.Admission(2, 0, "busy\n");
+    BoostAsioLib::ContextType ioc;
+    asiolib::ip::tcp::socket c1(ioc), c2(ioc), c3(ioc);
+    c1.connect(server.LocalEndpoint());
+    c2.connect(server.LocalEndpoint());
+    BOOST_CHECK(WaitStats(server, [](const ServerStats& s){ return s.active == 2; }));
+    c3.connect(server.LocalEndpoint());
+    BOOST_CHECK_EQUAL(ReadAll(c3), "busy\n");
+    auto stats = server.Stats();
+    BOOST_CHECK_EQUAL(stats.active, 2u);
+    BOOST_CHECK_EQUAL(stats.accepted, 2u);
+    BOOST_CHECK_EQUAL(stats.rejected, 1u);
+
+    // a place is free again when a session ends
+    c1.close();
+    BOOST_CHECK(WaitStats(server, [](const ServerStats& s){ return s.active == 1; }));
+    asiolib::ip::tcp::socket c4(ioc);
+    c4.connect(server.LocalEndpoint());
+    BOOST_CHECK(WaitStats(server, [](const ServerStats& s){ return s.active == 2 && s.accepted == 3; }));
+    asiolib::write(c4, asiolib::buffer(std::string("ping")));
+    std::string reply(4, '\0');
+    asiolib::read(c4, asiolib::buffer(&reply[0], reply.size()));
+    BOOST_CHECK_EQUAL(reply, "ping");
+}
+
+BOOST_AUTO_TEST_CASE(MaxSessionsPerAddress)
+{
+    for (std::size_t shards: {0, 2})
+    {
+        Runner runner;
+        EchoServer server(runner.ioc, shards);
+        server.Admission(0, 1);
+        BoostAsioLib::ContextType ioc;
+        asiolib::ip::tcp::socket c1(ioc), c2(ioc);
+        c1.connect(server.LocalEndpoint());
+        BOOST_CHECK(WaitStats(server, [](const ServerStats& s){ return s.active == 1; }));
+        c2.connect(server.LocalEndpoint());
+        BOOST_CHECK_EQUAL(ReadAll(c2), "");
+        BOOST_CHECK(WaitStats(server, [](const ServerStats& s){ return s.rejected == 1; }));
+        c1.close();
+        BOOST_CHECK(WaitStats(server, [](const ServerStats& s){ return s.active == 0; }));
+    }
+}
+
+#if defined(__linux__)
+BOOST_AUTO_TEST_CASE(AcceptBackoff)
+{
+    Runner runner;
+    EchoServer server(runner.ioc, 0);
+    BoostAsioLib::ContextType ioc;
+    asiolib::ip::tcp::socket client(ioc, asiolib::ip::tcp::v4());
+    std::vector<int> fds;
+    rlimit old{};
+    getrlimit(RLIMIT_NOFILE, &old);
+    {
+        // no file descriptors left for the server
+        rlimit limited = old;
+        limited.rlim_cur = static_cast<rlim_t>(dup(0) + 1);
+        fds.push_back(static_cast<int>(limited.rlim_cur) - 1);
+        setrlimit(RLIMIT_NOFILE, &limited);
+        for (int fd = dup(0); fd >= 0; fd = dup(0))
+            fds.push_back(fd);
+        client.connect(server.LocalEndpoint());
+    }
+    // the accept fails a few times, without spinning
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto errors = server.Stats().errors;
+    for (int fd: fds)
+        close(fd);
+    setrlimit(RLIMIT_NOFILE, &old);
+    BOOST_CHECK(errors >= 2);
+    BOOST_CHECK(errors < 10);
+    // and succeeds when the descriptors are available again
+    asiolib::write(client, asiolib::buffer(std::string("ping")));
+    std::string reply(4, '\0');
+    asiolib::read(client, asiolib::buffer(&reply[0], reply.size()));
+    BOOST_CHECK_EQUAL(reply, "ping");
+    BOOST_CHECK_EQUAL(server.Stats().accepted, 1u);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(IdleTimeout)
+{
+    for (std::size_t shards: {0, 2})
+    {
+        Runner runner;
+        EchoServer server(runner.ioc, shards);
+        server.Timeouts(std::chrono::milliseconds(300), std::chrono::milliseconds(0), std::chrono::milliseconds(150), "idle\n");
+        BoostAsioLib::ContextType ioc;
+        asiolib::ip::tcp::socket client(ioc);
+        client.connect(server.LocalEndpoint());
+
+        // the input keeps the session alive, without warnings
+        auto last = std::chrono::steady_clock::now();
+        for (int i = 0; i < 6; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            asiolib::write(client, asiolib::buffer(std::string("x")));
+            last = std::chrono::steady_clock::now();
+            char c = 0;
+            asiolib::read(client, asiolib::buffer(&c, 1));
+            BOOST_CHECK_EQUAL(c, 'x');
+        }
+        // then the session is warned and closed
+        BOOST_CHECK_EQUAL(ReadAll(client), "idle\n");
+        const auto elapsed = std::chrono::steady_clock::now() - last;
+        BOOST_CHECK(elapsed >= std::chrono::milliseconds(300));
+        BOOST_CHECK(elapsed < std::chrono::milliseconds(1000));
+        BOOST_CHECK(WaitStats(server, [](const ServerStats& st){ return st.active == 0; }));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(AbsoluteTimeout)
+{
+    for (std::size_t shards: {0, 2})
+    {
+        Runner runner;
+        EchoServer server(runner.ioc, shards);
+        server.Timeouts(std::chrono::milliseconds(0), std::chrono::milliseconds(400));
+        BoostAsioLib::ContextType ioc;
+        asiolib::ip::tcp::socket client(ioc);
+        const auto start = std::chrono::steady_clock::now();
+        client.connect(server.LocalEndpoint());
+
+        // the input does not postpone the absolute timeout
+        asiolibec::error_code ec;
+        std::size_t echoed = 0;
+        while (!ec)
+        {
+            asiolib::write(client, asiolib::buffer(std::string("x")), ec);
+            char c = 0;
+            if (!ec)
+                echoed += asiolib::read(client, asiolib::buffer(&c, 1), ec);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        BOOST_CHECK(echoed >= 4);
+        BOOST_CHECK(elapsed >= std::chrono::milliseconds(400));
+        BOOST_CHECK(elapsed < std::chrono::milliseconds(1500));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ManyTimeouts)
+{
+    // sessions closed by the client before their deadline, and by the server
+    Runner runner;
+    EchoServer server(runner.ioc, 0);
+    server.Timeouts(std::chrono::milliseconds(200), std::chrono::milliseconds(0));
+    BoostAsioLib::ContextType ioc;
+    for (int i = 0; i < 50; ++i)
+    {
+        asiolib::ip::tcp::socket client(ioc);
+        client.connect(server.LocalEndpoint());
+    }
+    BOOST_CHECK(WaitStats(server, [](const ServerStats& st){ return st.accepted == 50 && st.active == 0; }));
+    std::vector<std::unique_ptr<asiolib::ip::tcp::socket>> clients;
+    for (int i = 0; i < 50; ++i)
+    {
+        clients.push_back(std::make_unique<asiolib::ip::tcp::socket>(ioc));
+        clients.back()->connect(server.LocalEndpoint());
+    }
+    for (auto& c: clients)
+        BOOST_CHECK_EQUAL(ReadAll(*c), "");
+    BOOST_CHECK(WaitStats(server, [](const ServerStats& st){ return st.active == 0; }));
+}
+
+BOOST_AUTO_TEST_CASE(KeepAlive)
+{
+    Runner runner;
+    EchoServer server(runner.ioc, 0);
+    BoostAsioLib::ContextType ioc;
+    // connects a client, and waits until the session echoes
+    auto connect = [&](asiolib::ip::tcp::socket& client)
+    {
+        client.connect(server.LocalEndpoint());
+        asiolib::write(client, asiolib::buffer(std::string("x")));
+        char c = 0;
+        asiolib::read(client, asiolib::buffer(&c, 1));
+    };
+    {
+        asiolib::ip::tcp::socket client(ioc);
+        connect(client);
+        BOOST_CHECK(!server.keepAlive);
+    }
+    server.KeepAlive(std::chrono::seconds(60), std::chrono::seconds(10), 3);
+    asiolib::ip::tcp::socket client(ioc);
+    connect(client);
+    BOOST_CHECK(server.keepAlive);
+}
+
+BOOST_AUTO_TEST_CASE(LargeInput)
+{
+    // the receive buffer grows for a large input (e.g., a paste), and shrinks back after it
+    Runner runner;
+    EchoServer server(runner.ioc, 0);
+    BoostAsioLib::ContextType ioc;
+    asiolib::ip::tcp::socket client(ioc);
+    client.connect(server.LocalEndpoint());
+    std::string input(1024 * 1024, 'x');
+    for (std::size_t i = 0; i < input.size(); i += 100)
+        input[i] = static_cast<char>('a' + (i / 100) % 26);
+    std::thread writer([&](){ asiolib::write(client, asiolib::buffer(input)); });
+    std::string echo(input.size(), '\0');
+    asiolib::read(client, asiolib::buffer(&echo[0], echo.size()));
+    writer.join();
+    BOOST_CHECK(echo == input);
+    {
+        std::lock_guard<std::mutex> lock(server.threads.mutex);
+        BOOST_CHECK(server.threads.largestRead > 1024);
+        BOOST_CHECK(server.threads.largestRead <= BufferPool::Shared()->MaxSize());
+    }
+
+    // then small reads
+    const auto before = BufferPool::Shared()->Statistics();
+    for (int i = 0; i < 100; ++i)
+    {
+        asiolib::write(client, asiolib::buffer(std::string("y")));
+        char c = 0;
+        asiolib::read(client, asiolib::buffer(&c, 1));
+        BOOST_CHECK_EQUAL(c, 'y');
+    }
+    const auto after = BufferPool::Shared()->Statistics();
+    BOOST_CHECK(after.reused > before.reused); // shrunk with the buffers released while growing
+    BOOST_CHECK_EQUAL(after.allocated, before.allocated);
+}
+
+BOOST_AUTO_TEST_CASE(TelnetEncoding)
+{
+    BoostAsioLib::ContextType ioc;
+    asiolib::ip::tcp::socket socket(ioc, asiolib::ip::tcp::v4());
+    TestTelnetSession session(std::move(socket));
+    BOOST_CHECK_EQUAL(session.Encoded(""), "");
+    BOOST_CHECK_EQUAL(session.Encoded("abc"), "abc");
+    BOOST_CHECK_EQUAL(session.Encoded("\n"), "\r\n");
+    BOOST_CHECK_EQUAL(session.Encoded("a\nb\n\nc"), "a\r\nb\r\n\r\nc");
+    BOOST_CHECK_EQUAL(session.Encoded("\xFF"), "\xFF\xFF");
+    BOOST_CHECK_EQUAL(session.Encoded("a\xFF\nb\n\xFF\xFF"), "a\xFF\xFF\r\nb\r\n\xFF\xFF\xFF\xFF");
+    const std::string big = std::string(5000, 'x') + '\n' + std::string(5000, 'y');
+    BOOST_CHECK_EQUAL(session.Encoded(big), std::string(5000, 'x') + "\r\n" + std::string(5000, 'y'));
+}
+
+BOOST_AUTO_TEST_CASE(TelnetParsing)
+{
+    BoostAsioLib::ContextType ioc;
+    TestTelnetSession session(asiolib::ip::tcp::socket(ioc, asiolib::ip::tcp::v4()));
+
+    session.Receive("hello world");
+    BOOST_CHECK_EQUAL(session.received, "hello world");
+    BOOST_CHECK_EQUAL(session.runs, 1u);
+
+    // the commands split the data, and an escaped IAC is data
+    session.received.clear();
+    session.runs = 0;
+    static const char data[] = "ab\xFF\xF1" "cd\xFF\xFF" "ef\xFF\xFC\x01gh\xFF\xFA\x1F\x00\x50\xFF\xF0ij";
+    session.Receive(std::string(data, sizeof(data) - 1));
+    BOOST_CHECK_EQUAL(session.received, "abcd\xFF" "efghij");
+    BOOST_CHECK_EQUAL(session.runs, 5u);
+
+    // a command split between two reads
+    session.received.clear();
+    session.Receive("xy\xFF");
+    session.Receive("\xFC");
+    session.Receive(std::string("\x01z", 2));
+    BOOST_CHECK_EQUAL(session.received, "xyz");
+}
+
+BOOST_AUTO_TEST_CASE(TelnetParsingSpeed)
+{
+    // the elapsed times are shown with --log_level=message
+    BoostAsioLib::ContextType ioc;
+    TestTelnetSession session(asiolib::ip::tcp::socket(ioc, asiolib::ip::tcp::v4()));
+    std::string block(64 * 1024, 'x');
+    for (std::size_t i = 0; i < block.size(); i += 80)
+        block[i] = '\r';
+    const std::size_t rounds = 2000;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < rounds; ++i)
+    {
+        session.Receive(block);
+        session.received.clear();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    BOOST_CHECK_EQUAL(session.runs, rounds);
+    BOOST_TEST_MESSAGE("telnet parsing without IAC: " << static_cast<double>(block.size() * rounds) / elapsed.count() / 1e6 << " MB/s");
+}
+
+BOOST_AUTO_TEST_CASE(CliTelnet)
+{
+    // the same keys give the same command, however they are split by the reads
+    static const char typed[] = "ec\xFF\xF1ho abcX\x7F\x1b[D\x1b[C\r"; // the trailing 0 is part of the ENTER
+    const std::string keys(typed, sizeof(typed));
+    for (std::size_t chunk: {keys.size(), std::size_t(1), std::size_t(3)})
+    {
+        std::vector<std::string> executed;
+        auto root = std::make_unique<Menu>("cli");
+        root->Insert("echo", [&](std::ostream&, const std::string& arg){ executed.push_back(arg); });
+        Cli cli(std::move(root));
+        LoopScheduler scheduler;
+        BoostAsioLib::ContextType ioc;
+        asiolib::ip::tcp::acceptor acceptor(ioc, asiolib::ip::tcp::endpoint(asiolib::ip::address_v4::loopback(), 0));
+        asiolib::ip::tcp::socket client(ioc);
+        client.connect(acceptor.local_endpoint());
+        asiolib::ip::tcp::socket socket(ioc);
+        acceptor.accept(socket);
+        auto session = std::make_shared<CliTelnetSession>(scheduler, std::move(socket), cli, [](std::ostream&){}, 10);
+        session->Start();
+        for (std::size_t i = 0; i < keys.size(); i += chunk)
+        {
+            asiolib::write(client, asiolib::buffer(keys.substr(i, chunk)));
+            for (int j = 0; j < 100 && client.available() == 0; ++j)
+            {
+                ioc.poll();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            // runs the handlers of the data just received
+            for (int j = 0; j < 5; ++j)
+            {
+                ioc.poll();
+                while (scheduler.PollOne()) {}
+            }
+            std::vector<char> drain(client.available());
+            if (!drain.empty())
+                client.read_some(asiolib::buffer(drain));
+        }
+        BOOST_REQUIRE_EQUAL(executed.size(), 1u);
+        BOOST_CHECK_EQUAL(executed[0], "abc");
+        asiolibec::error_code ec;
+        client.close(ec);
+        ioc.poll();
+        while (scheduler.PollOne()) {}
+    }
+}
+
+namespace
+{
+
+struct TelnetRun
+{
+    std::vector<std::string> executed;
+    std::string output;
+    std::size_t tasks = 0; // run by the scheduler after the first prompt
+};
+
+// sends keys to a CliTelnetSession in chunks of the size specified,
+// running the handlers of each chunk before sending the next one
+TelnetRun RunTelnet(const std::string& keys, std::size_t chunk, bool suggestions = false)
+{
+    TelnetRun result;
+    auto root = std::make_unique<Menu>("cli");
+    root->Insert("echo", [&](std::ostream& out, const std::string& arg){ result.executed.push_back(arg); out << arg << '\n'; });
+    Cli cli(std::move(root));
+    cli.AutoSuggestions(suggestions);
+    LoopScheduler scheduler;
+    BoostAsioLib::ContextType ioc;
+    asiolib::ip::tcp::acceptor acceptor(ioc, asiolib::ip::tcp::endpoint(asiolib::ip::address_v4::loopback(), 0));
+    asiolib::ip::tcp::socket client(ioc);
+    client.connect(acceptor.local_endpoint());
+    client.set_option(asiolib::ip::tcp::no_delay(true)); // the keys can be sent one at a time
+    asiolib::ip::tcp::socket socket(ioc);
+    acceptor.accept(socket);
+    socket.set_option(asiolib::ip::tcp::no_delay(true)); // as the server does
+    auto session = std::make_shared<CliTelnetSession>(scheduler, std::move(socket), cli, [](std::ostream&){}, 10);
+    session->Start();
+    // runs the handlers until nothing happens for a while
+    auto drain = [&]()
+    {
+        for (int idle = 0; idle < 5; )
+        {
+            bool busy = ioc.poll() != 0;
+            while (scheduler.PollOne())
+            {
+                ++result.tasks;
+                busy = true;
+            }
+            while (client.available() != 0)
+            {
+                std::vector<char> data(client.available());
+                client.read_some(asiolib::buffer(data));
+                result.output.append(data.begin(), data.end());
+                busy = true;
+            }
+            if (busy)
+                idle = 0;
+            else
+            {
+                ++idle;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    };
+    drain();
+    result.tasks = 0;
+    for (std::size_t i = 0; i < keys.size(); i += chunk)
+    {
+        asiolib::write(client, asiolib::buffer(keys.substr(i, chunk)));
+        drain();
+    }
+    asiolibec::error_code ec;
+    client.close(ec);
+    ioc.poll();
+    while (scheduler.PollOne()) {}
+    return result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(CliTelnetLines)
+{
+    // the lines pipelined in a single read give the same commands and the same output
+    // as the same keys received one at a time, using a task for all the lines
+    std::string keys;
+    for (int i = 0; i < 200; ++i)
+        keys += "echo " + std::to_string(i) + (i % 2 ? "\r\n" : std::string("\r\0", 2));
+    keys += "echo x\x7F" "200" + std::string("\r\0", 2) + "ec";
+    keys += "ho 201" + std::string("\r\0", 2);
+    const auto byKey = RunTelnet(keys, 1);
+    BOOST_REQUIRE_EQUAL(byKey.executed.size(), 202u);
+    BOOST_CHECK_EQUAL(byKey.executed[0], "0");
+    BOOST_CHECK_EQUAL(byKey.executed[200], "200");
+    BOOST_CHECK_EQUAL(byKey.executed[201], "201");
+    for (std::size_t chunk: {keys.size(), std::size_t(7), std::size_t(100)})
+    {
+        const auto r = RunTelnet(keys, chunk);
+        BOOST_CHECK(r.executed == byKey.executed);
+        BOOST_CHECK(r.output == byKey.output);
+    }
+    const auto whole = RunTelnet(keys, keys.size());
+    BOOST_TEST_MESSAGE("scheduler tasks for " << keys.size() << " bytes: " << byKey.tasks << " (one byte at a time), " << whole.tasks << " (single read)");
+    BOOST_CHECK(whole.tasks < 20);
+    // with the suggestions, as well
+    BOOST_CHECK(RunTelnet(keys, keys.size(), true).executed == byKey.executed);
+}
+
+BOOST_AUTO_TEST_CASE(CliTelnetPaste)
+{
+    // the keys of a read (text and escape sequences) are handled by a single task
+    std::string text;
+    for (int i = 0; i < 3000; ++i)
+        text += static_cast<char>('a' + i % 26);
+    std::string keys = "echo " + text + "\x7F\x7F" "\x1b[DX\x1b[C" "\x1b[" "3~" "!" + std::string("\r\0", 2);
+    std::string expected = text.substr(0, text.size() - 2);
+    expected.insert(expected.size() - 1, "X");
+    expected += '!';
+    const auto small = RunTelnet(keys, 16);
+    BOOST_REQUIRE_EQUAL(small.executed.size(), 1u);
+    BOOST_CHECK_EQUAL(small.executed[0], expected);
+    const auto whole = RunTelnet(keys, keys.size());
+    BOOST_CHECK(whole.executed == small.executed);
+    BOOST_CHECK(whole.output == small.output);
+    BOOST_TEST_MESSAGE("scheduler tasks for a paste of " << keys.size() << " bytes: " << whole.tasks << " (single write), " << small.tasks << " (16 bytes at a time)");
+    BOOST_CHECK(whole.tasks < 10);
+    for (std::size_t chunk: {keys.size(), std::size_t(5)})
+        BOOST_CHECK(RunTelnet(keys, chunk, true).executed == small.executed);
+}
+
+namespace
+{
+
+// a client of the machine protocol
+struct MachineClient
+{
+    struct Response
+    {
+        std::string id;
+        std::string status;
+        long long micros = -1;
+        std::string output;
+    };
+    explicit MachineClient(const asiolib::ip::tcp::endpoint& endpoint) : socket(ioc)
+    {
+        socket.connect(endpoint);
+    }
+    void Send(const std::string& data)
+    {
+        asiolib::write(socket, asiolib::buffer(data));
+    }
+    Response Receive()
+    {
+        Response r;
+        asiolibec::error_code ec;
+        asiolib::read_until(socket, input, '\n', ec);
+        if (ec)
+            return r;
+        std::istream is(&input);
+        std::size_t length = 0;
+        is >> r.id >> r.status >> r.micros >> length;
+        is.ignore(1); // '\n'
+        if (input.size() < length)
+            asiolib::read(socket, input, asiolib::transfer_exactly(length - input.size()), ec);
+        r.output.resize(length);
+        is.read(&r.output[0], static_cast<std::streamsize>(length));
+        return r;
+    }
+    bool Closed()
+    {
+        char c;
+        asiolibec::error_code ec;
+        socket.read_some(asiolib::buffer(&c, 1), ec);
+        return ec == asiolib::error::eof;
+    }
+    BoostAsioLib::ContextType ioc;
+    asiolib::ip::tcp::socket socket;
+    asiolib::streambuf input;
+};
+
+// a machine server on a cli with a few commands, running in its own thread
+struct MachineServer
+{
+    explicit MachineServer(std::size_t shards = 0, ShardMode mode = ShardMode::io) :
+        cli(Root()),
+        server(cli, scheduler, "127.0.0.1", 0, 100, shards, mode),
+        thread([this](){ scheduler.Run(); })
+    {}
+    ~MachineServer()
+    {
+        scheduler.Stop();
+        thread.join();
+    }
+    static std::unique_ptr<Menu> Root()
+    {
+        auto root = std::make_unique<Menu>("cli");
+        root->Insert("echo", [](std::ostream& out, const std::string& arg){ out << arg << '\n'; });
+        root->Insert("fail", [](std::ostream&){ throw std::runtime_error("failure"); });
+        root->Insert("sleep", [](std::ostream&, int ms){ std::this_thread::sleep_for(std::chrono::milliseconds(ms)); });
+        auto sub = std::make_unique<Menu>("sub");
+        sub->Insert("inner", [](std::ostream& out){ out << "in sub\n"; });
+        root->Insert(std::move(sub));
+        return root;
+    }
+    Cli cli;
+    GenericAsioScheduler<BoostAsioLib> scheduler;
+    CliGenericMachineServer<BoostAsioLib> server;
+    std::thread thread;
+};
+
+} // namespace
+
+namespace
+{
+
+// a telnet server on the cli of MachineServer, running in its own thread
+struct TelnetServer
+{
+    TelnetServer(std::size_t shards, ShardMode mode) :
+        cli(MachineServer::Root()),
+        server(cli, scheduler, "127.0.0.1", 0, 100, shards, mode),
+        thread([this](){ scheduler.Run(); })
+    {}
+    ~TelnetServer()
+    {
+        scheduler.Stop();
+        thread.join();
+    }
+    Cli cli;
+    GenericAsioScheduler<BoostAsioLib> scheduler;
+    CliGenericTelnetServer<BoostAsioLib> server;
+    std::thread thread;
+};
+
+// reads from client until done returns true for the data received (for 5 seconds at most)
+template <typename P>
+std::string ReadUntil(asiolib::ip::tcp::socket& client, P done)
+{
+    std::string result;
+    client.non_blocking(true);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!done(result) && std::chrono::steady_clock::now() < deadline)
+    {
+        char buffer[4096];
+        asiolibec::error_code ec;
+        const auto n = client.read_some(asiolib::buffer(buffer), ec);
+        if (ec == asiolib::error::would_block || ec == asiolib::error::try_again)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        else if (ec)
+            break;
+        result.append(buffer, n);
+    }
+    return result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(ShardedCout)
+{
+    for (auto mode: {ShardMode::io, ShardMode::sessions})
+    {
+        TelnetServer ts(2, mode);
+        BoostAsioLib::ContextType ioc;
+        asiolib::ip::tcp::socket client(ioc);
+        client.connect(ts.server.LocalEndpoint());
+        ReadUntil(client, [](const std::string& r){ return r.find("> ") != std::string::npos; }); // the session is ready
+
+        // the session writes the output of its commands, while another thread writes on Cli::cout()
+        const int lines = 200;
+        std::thread writer([](){
+            for (int i = 0; i < lines; ++i)
+                Cli::cout() << "broadcast " << i << '.' << std::endl;
+        });
+        const int commands = 50;
+        for (int i = 0; i < commands; ++i)
+            asiolib::write(client, asiolib::buffer("echo command" + std::to_string(i) + ".\r\n"));
+        writer.join();
+
+        const std::string last = "command" + std::to_string(commands - 1) + '.';
+        const auto received = ReadUntil(client, [&](const std::string& r)
+        {
+            const auto echo = r.find(last); // the echo of the input, then the output
+            return r.find("broadcast " + std::to_string(lines - 1) + '.') != std::string::npos &&
+                   echo != std::string::npos && r.find(last, echo + 1) != std::string::npos;
+        });
+        // all the lines, in order
+        std::size_t pos = 0;
+        for (int i = 0; i < lines && pos != std::string::npos; ++i)
+            pos = received.find("broadcast " + std::to_string(i) + '.', pos);
+        BOOST_CHECK(pos != std::string::npos);
+        for (int i = 0; i < commands; ++i)
+            BOOST_CHECK(received.find("command" + std::to_string(i) + '.') != std::string::npos);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MachinePipelining)
+{
+    for (auto shards: {std::make_pair(0, ShardMode::io), std::make_pair(2, ShardMode::io), std::make_pair(2, ShardMode::sessions)})
+    {
+        MachineServer ms(static_cast<std::size_t>(shards.first), shards.second);
+        MachineClient client(ms.server.LocalEndpoint());
+        // all the requests at once
+        client.Send("1 echo hello\n2 foo bar\r\n\n3 fail\nx4\n5 sleep 20\n6 echo bye\n");
+        auto r = client.Receive();
+        BOOST_CHECK_EQUAL(r.id, "1");
+        BOOST_CHECK_EQUAL(r.status, "ok");
+        BOOST_CHECK(r.micros >= 0);
+        BOOST_CHECK_EQUAL(r.output, "hello\n");
+        r = client.Receive();
+        BOOST_CHECK_EQUAL(r.id, "2");
+        BOOST_CHECK_EQUAL(r.status, "wrong-command");
+        BOOST_CHECK_EQUAL(r.output, "wrong command: foo bar\n");
+        r = client.Receive();
+        BOOST_CHECK_EQUAL(r.id, "3");
+        BOOST_CHECK_EQUAL(r.status, "error");
+        BOOST_CHECK(r.output.find("failure") != std::string::npos);
+        r = client.Receive();
+        BOOST_CHECK_EQUAL(r.id, "x4"); // no command
+        BOOST_CHECK_EQUAL(r.status, "ok");
+        BOOST_CHECK_EQUAL(r.output, "");
+        r = client.Receive();
+        BOOST_CHECK_EQUAL(r.id, "5");
+        BOOST_CHECK(r.micros >= 20000);
+        r = client.Receive();
+        BOOST_CHECK_EQUAL(r.id, "6");
+        BOOST_CHECK_EQUAL(r.output, "bye\n");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MachineMenusAndExit)
+{
+    MachineServer ms;
+    MachineClient client(ms.server.LocalEndpoint());
+    // a request split among many writes
+    for (char c: std::string("a sub\nb inner\n"))
+        client.Send(std::string(1, c));
+    BOOST_CHECK_EQUAL(client.Receive().status, "ok");
+    auto r = client.Receive();
+    BOOST_CHECK_EQUAL(r.id, "b");
+    BOOST_CHECK_EQUAL(r.output, "in sub\n");
+    // the requests after exit are ignored
+    client.Send("c exit\nd echo x\n");
+    r = client.Receive();
+    BOOST_CHECK_EQUAL(r.id, "c");
+    BOOST_CHECK_EQUAL(r.status, "ok");
+    BOOST_CHECK(client.Closed());
+}
+
+BOOST_AUTO_TEST_CASE(MachineHistory)
+{
+    MachineServer ms;
+    ms.cli.AutoSuggestions(true);
+    std::stringstream oss;
+    CliSession interactive(ms.cli, oss);
+    {
+        MachineClient client(ms.server.LocalEndpoint());
+        client.Send("1 echo hello\n2 exit\n");
+        BOOST_CHECK_EQUAL(client.Receive().output, "hello\n");
+        BOOST_CHECK(client.Closed());
+    }
+    // the commands of the machine sessions are not seen by the interactive ones
+    BOOST_CHECK_EQUAL(interactive.PreviousCmd(""), "");
+    BOOST_CHECK_EQUAL(interactive.Suggestion("e"), "");
+    CliSession later(ms.cli, oss); // loads the storage
+    BOOST_CHECK_EQUAL(later.PreviousCmd(""), "");
+}
+
+BOOST_AUTO_TEST_CASE(MachineBadRequest)
+{
+    MachineServer ms;
+    {
+        MachineClient client(ms.server.LocalEndpoint());
+        client.Send("1 echo a\n echo without id\n2 echo b\n");
+        BOOST_CHECK_EQUAL(client.Receive().id, "1");
+        auto r = client.Receive();
+        BOOST_CHECK_EQUAL(r.id, "-");
+        BOOST_CHECK_EQUAL(r.status, "bad-request");
+        BOOST_CHECK(client.Closed());
+    }
+    {
+        MachineClient client(ms.server.LocalEndpoint());
+        client.Send("1 echo " + std::string(100 * 1024, 'x'));
+        auto r = client.Receive();
+        BOOST_CHECK_EQUAL(r.status, "bad-request");
+        BOOST_CHECK(client.Closed());
+    }
+}
+
+#ifdef CLI_USE_ZLIB
+
+namespace
+{
+
+// decompresses a zlib stream flushed with Z_SYNC_FLUSH
+std::string Inflate(const std::string& data)
+{
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) return {};
+    std::string result;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    char buffer[4096];
+    int res = Z_OK;
+    do
+    {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        res = inflate(&stream, Z_SYNC_FLUSH);
+        result.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (res == Z_OK && stream.avail_out == 0);
+    inflateEnd(&stream);
+    return result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(DeflaterRoundTrip)
+{
+    Deflater deflater(6);
+    std::string compressed;
+    const std::string text = std::string(10000, 'a') + "hello\n";
+    deflater.Compress(text.data(), text.size(), compressed);
+    deflater.Flush(compressed);
+    BOOST_CHECK(compressed.size() < text.size());
+    BOOST_CHECK_EQUAL(Inflate(compressed), text);
+    BOOST_CHECK_EQUAL(deflater.In(), text.size());
+    BOOST_CHECK_EQUAL(deflater.Out(), compressed.size());
+
+    // every flush makes the whole stream decodable
+    deflater.Compress("more", 4, compressed);
+    deflater.Flush(compressed);
+    BOOST_CHECK_EQUAL(Inflate(compressed), text + "more");
+}
+
+BOOST_AUTO_TEST_CASE(TelnetCompression)
+{
+    BasicConnection<TestTelnetSession> c([](TestTelnetSession& s){ s.Compression(6); });
+    const std::string will = "\xFF\xFB\x56";
+    std::string negotiation = c.Receive(1000);
+    for (int i = 0; i < 100 && negotiation.find(will) == std::string::npos; ++i)
+        negotiation += c.Receive(1);
+    BOOST_CHECK(negotiation.find(will) != std::string::npos);
+    BOOST_CHECK_EQUAL(c.session->CompressionRatio(), 0.0);
+
+    const std::string doCompress = "\xFF\xFD\x56";
+    asiolib::write(c.client, asiolib::buffer(doCompress));
+    const std::string marker = "\xFF\xFA\x56\xFF\xF0";
+    std::string received = c.Receive(marker.size());
+    BOOST_REQUIRE_EQUAL(received.substr(0, marker.size()), marker);
+
+    std::string expected;
+    for (int i = 0; i < 200; ++i)
+    {
+        c.session->OutStream() << "line " << i << '\n';
+        expected += "line " + std::to_string(i) + "\r\n";
+    }
+    c.session->OutStream() << std::flush;
+    for (int i = 0; i < 100 && Inflate(received.substr(marker.size())).size() < expected.size(); ++i)
+        received += c.Receive(1);
+    BOOST_CHECK_EQUAL(Inflate(received.substr(marker.size())), expected);
+    BOOST_CHECK(received.size() - marker.size() < expected.size());
+    BOOST_CHECK(c.session->CompressionRatio() > 1.0);
+}
+
+#endif // CLI_USE_ZLIB
+
+BOOST_AUTO_TEST_SUITE_END()
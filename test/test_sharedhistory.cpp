@@ -0,0 +1,188 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <set>
+#include "cli/detail/sharedhistory.h"
+
+using namespace cli;
+using namespace cli::detail;
+
+BOOST_AUTO_TEST_SUITE(SharedHistorySuite)
+
+std::vector<std::string> ReadAll(const SharedHistory& h, SharedHistory::Cursor& c)
+{
+    std::vector<std::string> result;
+    h.Read(c, [&result](const std::string& cmd){ result.push_back(cmd); });
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(Basics)
+{
+    SharedHistory h(10);
+    auto c1 = h.NewCursor();
+    auto c2 = h.NewCursor();
+
+    h.Append(c1, "item1");
+    h.Append(c2, "item2");
+    h.Append(c1, "item3");
+
+    // each cursor skips its own commands
+    auto r1 = ReadAll(h, c1);
+    const std::vector<std::string> expected1 = { "item2" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(r1.begin(), r1.end(), expected1.begin(), expected1.end());
+
+    auto r2 = ReadAll(h, c2);
+    const std::vector<std::string> expected2 = { "item1", "item3" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(r2.begin(), r2.end(), expected2.begin(), expected2.end());
+
+    // nothing new
+    BOOST_CHECK(ReadAll(h, c1).empty());
+    BOOST_CHECK(ReadAll(h, c2).empty());
+
+    // a new cursor gets only the new commands
+    auto c3 = h.NewCursor();
+    BOOST_CHECK(ReadAll(h, c3).empty());
+    h.Append(c1, "item4");
+    auto r3 = ReadAll(h, c3);
+    const std::vector<std::string> expected3 = { "item4" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(r3.begin(), r3.end(), expected3.begin(), expected3.end());
+}
+
+BOOST_AUTO_TEST_CASE(Overwrite)
+{
+    SharedHistory h(3);
+    auto c1 = h.NewCursor();
+    auto c2 = h.NewCursor();
+
+    for (auto i: { "item1", "item2", "item3", "item4", "item5" })
+        h.Append(c1, i);
+
+    // the oldest commands are lost
+    auto r = ReadAll(h, c2);
+    const std::vector<std::string> expected = { "item3", "item4", "item5" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(r.begin(), r.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(Identity)
+{
+    SharedHistory h(10);
+    auto c1 = h.NewCursor("user1");
+    auto c2 = h.NewCursor("user1");
+    auto c3 = h.NewCursor("user2");
+
+    h.Append(c1, "item1");
+    h.Append(c3, "item2");
+
+    auto r2 = ReadAll(h, c2);
+    const std::vector<std::string> expected2 = { "item1" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(r2.begin(), r2.end(), expected2.begin(), expected2.end());
+    BOOST_CHECK(ReadAll(h, c3).empty());
+}
+
+BOOST_AUTO_TEST_CASE(Concurrency)
+{
+    SharedHistory h(100000);
+    auto reader = h.NewCursor();
+
+    const int nThreads = 4;
+    const int nCmds = 1000;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < nThreads; ++t)
+        writers.emplace_back(
+            [&h, t]()
+            {
+                auto c = h.NewCursor();
+                for (int i = 0; i < nCmds; ++i)
+                    h.Append(c, std::to_string(t) + '_' + std::to_string(i));
+            }
+        );
+
+    std::set<std::string> got;
+    for (int i = 0; i < 100; ++i)
+        h.Read(reader, [&got](const std::string& cmd){ got.insert(cmd); });
+
+    for (auto& w: writers)
+        w.join();
+    h.Read(reader, [&got](const std::string& cmd){ got.insert(cmd); });
+
+    BOOST_CHECK_EQUAL(got.size(), static_cast<std::size_t>(nThreads*nCmds));
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrencySmallCapacity)
+{
+    for (std::size_t capacity: { 1, 2 })
+    {
+        SharedHistory h(capacity);
+        auto reader = h.NewCursor();
+
+        const int nThreads = 4;
+        const int nCmds = 2000;
+        std::vector<std::thread> writers;
+        for (int t = 0; t < nThreads; ++t)
+            writers.emplace_back(
+                [&h, t]()
+                {
+                    auto c = h.NewCursor();
+                    for (int i = 0; i < nCmds; ++i)
+                        h.Append(c, std::to_string(t) + '_' + std::to_string(i));
+                }
+            );
+
+        // the commands of each writer must come in order, and never twice
+        std::vector<int> last(nThreads, -1);
+        bool ordered = true;
+        auto check = [&](const std::string& cmd)
+        {
+            const auto sep = cmd.find('_');
+            const auto t = std::stoi(cmd.substr(0, sep));
+            const auto i = std::stoi(cmd.substr(sep + 1));
+            if (i <= last[t])
+                ordered = false;
+            last[t] = i;
+        };
+        for (int i = 0; i < 1000; ++i)
+            h.Read(reader, check);
+
+        for (auto& w: writers)
+            w.join();
+        h.Read(reader, check);
+        BOOST_CHECK(ordered);
+
+        // the reader is not stuck on a slot left with a stale sequence number
+        auto c = h.NewCursor();
+        h.Append(c, "last");
+        auto r = ReadAll(h, reader);
+        BOOST_REQUIRE(!r.empty());
+        BOOST_CHECK_EQUAL(r.back(), "last");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include "cli/detail/suggestionindex.h"
+
+using namespace cli::detail;
+
+BOOST_AUTO_TEST_SUITE(SuggestionIndexSuite)
+
+BOOST_AUTO_TEST_CASE(Basics)
+{
+    SuggestionIndex index;
+
+    BOOST_CHECK_EQUAL(index.Suggestion("s"), "");
+
+    index.Add("show interfaces");
+    index.Add("set address 1");
+    index.Add("show routes");
+
+    BOOST_CHECK_EQUAL(index.Suggestion(""), "");
+    BOOST_CHECK_EQUAL(index.Suggestion("x"), "");
+    BOOST_CHECK_EQUAL(index.Suggestion("s"), "show routes"); // the most recent
+    BOOST_CHECK_EQUAL(index.Suggestion("se"), "set address 1");
+    BOOST_CHECK_EQUAL(index.Suggestion("show i"), "show interfaces");
+    BOOST_CHECK_EQUAL(index.Suggestion("show routes"), ""); // nothing to add
+    BOOST_CHECK_EQUAL(index.Suggestion("show routes "), "");
+}
+
+BOOST_AUTO_TEST_CASE(Frecency)
+{
+    SuggestionIndex index(1000, 10);
+
+    // frequent
+    for (int i = 0; i < 5; ++i)
+        index.Add("show interfaces");
+    // but less recent
+    index.Add("show routes");
+    BOOST_CHECK_EQUAL(index.Suggestion("show"), "show interfaces");
+
+    // after a while, the recent command wins
+    for (int i = 0; i < 20; ++i)
+        index.Add("other" + std::to_string(i));
+    index.Add("show routes");
+    BOOST_CHECK_EQUAL(index.Suggestion("show"), "show routes");
+}
+
+BOOST_AUTO_TEST_CASE(Size)
+{
+    SuggestionIndex index(10, 1);
+
+    for (int i = 0; i < 1000; ++i) // rescale and shrink more times
+        index.Add("cmd" + std::to_string(i));
+
+    BOOST_CHECK_EQUAL(index.Suggestion("cm"), "cmd999");
+    BOOST_CHECK_EQUAL(index.Suggestion("cmd99"), "cmd999");
+    BOOST_CHECK_EQUAL(index.Suggestion("cmd995"), "");
+    BOOST_CHECK_EQUAL(index.Suggestion("cmd1"), ""); // too old
+}
+
+BOOST_AUTO_TEST_SUITE_END()
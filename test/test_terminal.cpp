@@ -0,0 +1,316 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include "cli/detail/terminal.h"
+
+using namespace std;
+using namespace cli::detail;
+
+namespace
+{
+
+// interprets the output of the terminal on a single line
+class Screen
+{
+public:
+    void Apply(const string& output)
+    {
+        for (size_t i = 0; i < output.size(); ++i)
+        {
+            const char c = output[i];
+            if (c == '\b') { if (cursor > 0) --cursor; }
+            else if (c == '\r') cursor = 0;
+            else if (c == '\x1b' && i+1 < output.size() && output[i+1] == '[')
+            {
+                i += 2;
+                size_t n = 0;
+                bool hasN = false;
+                while (i < output.size() && (isdigit(output[i]) || output[i] == ';'))
+                {
+                    if (output[i] != ';') { n = n*10 + static_cast<size_t>(output[i]-'0'); hasN = true; }
+                    ++i;
+                }
+                if (!hasN) n = 1;
+                switch (output[i])
+                {
+                    case 'D': cursor -= min(n, cursor); break;
+                    case 'C': cursor += n; Pad(); break;
+                    case '@': Pad(); line.insert(cursor, n, ' '); break;
+                    case 'P': Pad(); line.erase(cursor, n); break;
+                    case 'K': Pad(); line.erase(cursor); break;
+                    default: break; // colors
+                }
+            }
+            else
+            {
+                Pad();
+                if (cursor == line.size()) line += c;
+                else line[cursor] = c;
+                ++cursor;
+            }
+        }
+    }
+    // the line shown, without the trailing spaces
+    string Line() const
+    {
+        const auto last = line.find_last_not_of(' ');
+        return last == string::npos ? string() : line.substr(0, last+1);
+    }
+    size_t Cursor() const { return cursor; }
+private:
+    void Pad() { if (line.size() < cursor) line.resize(cursor, ' '); }
+    string line;
+    size_t cursor = 0;
+};
+
+struct Fixture
+{
+    explicit Fixture(bool ansi) : terminal(out, ansi) {}
+    // returns the number of bytes written for the key
+    size_t Key(KeyType type, char c = ' ')
+    {
+        out.str("");
+        terminal.Keypressed(make_pair(type, c));
+        screen.Apply(out.str());
+        return out.str().size();
+    }
+    size_t Type(const string& s)
+    {
+        size_t bytes = 0;
+        for (char c: s) bytes += Key(KeyType::ascii, c);
+        return bytes;
+    }
+    size_t SetLine(const string& s)
+    {
+        out.str("");
+        terminal.SetLine(s);
+        screen.Apply(out.str());
+        return out.str().size();
+    }
+    void Check(const string& expected, size_t cursor)
+    {
+        BOOST_CHECK_EQUAL(terminal.GetLine(), expected);
+        const auto last = expected.find_last_not_of(' ');
+        BOOST_CHECK_EQUAL(screen.Line(), last == string::npos ? string() : expected.substr(0, last+1));
+        BOOST_CHECK_EQUAL(screen.Cursor(), cursor);
+    }
+    stringstream out;
+    Terminal terminal;
+    Screen screen;
+};
+
+void Edit(bool ansi)
+{
+    Fixture f(ansi);
+    f.Type("hello world");
+    f.Check("hello world", 11);
+    for (int i = 0; i < 6; ++i) f.Key(KeyType::left);
+    f.Check("hello world", 5);
+    f.Type(",");
+    f.Check("hello, world", 6);
+    f.Key(KeyType::backspace);
+    f.Key(KeyType::backspace);
+    f.Check("hell world", 4);
+    f.Key(KeyType::canc);
+    f.Check("hellworld", 4);
+    f.Key(KeyType::home);
+    f.Check("hellworld", 0);
+    f.Key(KeyType::canc);
+    f.Check("ellworld", 0);
+    f.Key(KeyType::right);
+    f.Key(KeyType::right);
+    f.Check("ellworld", 2);
+    f.Key(KeyType::end);
+    f.Check("ellworld", 8);
+    f.SetLine("show all the commands");
+    f.Check("show all the commands", 21);
+    f.SetLine("show all commands");
+    f.Check("show all commands", 17);
+    f.SetLine("exit");
+    f.Check("exit", 4);
+    f.SetLine("");
+    f.Check("", 0);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(TerminalSuite)
+
+BOOST_AUTO_TEST_CASE(EditAnsi)
+{
+    Edit(true);
+}
+
+BOOST_AUTO_TEST_CASE(EditNoAnsi)
+{
+    Edit(false);
+}
+
+BOOST_AUTO_TEST_CASE(MinimalRedraw)
+{
+    Fixture f(true);
+    const string tail(200, 'x');
+    f.Type(tail);
+    f.Key(KeyType::home);
+    f.Check(tail, 0);
+
+    // the tail of the line is shifted by the terminal, not rewritten
+    BOOST_CHECK(f.Key(KeyType::ascii, 'a') < 10);
+    BOOST_CHECK(f.Key(KeyType::backspace) < 10);
+    BOOST_CHECK(f.Key(KeyType::canc) < 10);
+    f.Check(tail.substr(1), 0);
+    BOOST_CHECK(f.Key(KeyType::end) < 10);
+    f.Check(tail.substr(1), 199);
+
+    // only the different part of the new line is written
+    BOOST_CHECK(f.SetLine(tail.substr(1) + "y") < 10);
+    f.Check(tail.substr(1) + "y", 200);
+    BOOST_CHECK(f.SetLine("z" + tail.substr(1) + "y") < 20);
+    f.Check("z" + tail.substr(1) + "y", 201);
+
+    // without ANSI the tail must be rewritten
+    Fixture g(false);
+    g.Type(tail);
+    g.Key(KeyType::home);
+    BOOST_CHECK(g.Key(KeyType::ascii, 'a') > tail.size());
+    g.Check("a" + tail, 1);
+}
+
+BOOST_AUTO_TEST_CASE(RandomEdits)
+{
+    // lines with repeated characters, where the changes can be aligned in more ways
+    for (bool ansi: {true, false})
+    {
+        Fixture f(ansi);
+        string line;
+        size_t cursor = 0;
+        unsigned seed = 1;
+        auto random = [&seed](unsigned n){ seed = seed * 1103515245u + 12345u; return (seed / 65536u) % n; };
+        for (int i = 0; i < 2000; ++i)
+        {
+            switch (random(6))
+            {
+                case 0: case 1:
+                {
+                    const char c = "ab "[random(3)];
+                    f.Key(KeyType::ascii, c);
+                    line.insert(cursor++, 1, c);
+                    break;
+                }
+                case 2:
+                    f.Key(KeyType::backspace);
+                    if (cursor > 0) line.erase(--cursor, 1);
+                    break;
+                case 3:
+                    f.Key(KeyType::canc);
+                    if (cursor < line.size()) line.erase(cursor, 1);
+                    break;
+                case 4:
+                    f.Key(KeyType::left);
+                    if (cursor > 0) --cursor;
+                    break;
+                case 5:
+                    line = string(random(10), 'a') + string(random(3), 'b');
+                    f.SetLine(line);
+                    cursor = line.size();
+                    break;
+            }
+            f.Check(line, cursor);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Suggestion)
+{
+    for (bool ansi: {true, false})
+    {
+        Fixture f(ansi);
+        f.Type("sh");
+        f.out.str("");
+        f.terminal.Suggest("show");
+        f.screen.Apply(f.out.str());
+        BOOST_CHECK_EQUAL(f.screen.Line(), "show");
+        BOOST_CHECK_EQUAL(f.screen.Cursor(), 2u);
+        f.Key(KeyType::ascii, 'e');
+        f.Check("she", 3);
+        f.out.str("");
+        f.terminal.Suggest("shell");
+        f.screen.Apply(f.out.str());
+        f.Key(KeyType::end);
+        f.Check("shell", 5);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(WholeLine)
+{
+    // a line entered at once gives the same output and command as its keys and return
+    stringstream byKey;
+    Terminal keys(byKey);
+    BOOST_CHECK(keys.Empty());
+    for (char c: string("show all"))
+        keys.Keypressed(make_pair(KeyType::ascii, c));
+    BOOST_CHECK(!keys.Empty());
+    const auto expected = keys.Keypressed(make_pair(KeyType::ret, ' '));
+    BOOST_CHECK(keys.Empty());
+
+    stringstream whole;
+    Terminal line(whole);
+    const auto result = line.Line("show all");
+    BOOST_CHECK(result.first == Symbol::command);
+    BOOST_CHECK_EQUAL(result.second, expected.second);
+    BOOST_CHECK_EQUAL(whole.str(), byKey.str());
+    BOOST_CHECK(line.Empty());
+
+    // a suggestion shown is something pending
+    line.Suggest("show all");
+    BOOST_CHECK(!line.Empty());
+}
+
+BOOST_AUTO_TEST_CASE(NoFlush)
+{
+    // the terminal leaves to the caller the flush of the output
+    struct CountFlush : public stringbuf
+    {
+        int sync() override { ++flushes; return 0; }
+        int flushes = 0;
+    } buf;
+    ostream out(&buf);
+    Terminal terminal(out);
+    for (char c: string("hello"))
+        terminal.Keypressed(make_pair(KeyType::ascii, c));
+    terminal.Keypressed(make_pair(KeyType::home, ' '));
+    terminal.Keypressed(make_pair(KeyType::canc, ' '));
+    terminal.SetLine("world");
+    terminal.Suggest("worldwide");
+    BOOST_CHECK_EQUAL(buf.flushes, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,176 @@
+/*******************************************************************************
+ * CLI - A simple command line interface.
+ * Copyright (C) 2016-2021 Daniele Pallastrelli
+ *
+ * Boost Software License - Version 1.0 - August 17th, 2003
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ******************************************************************************/
+
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include <map>
+#include "cli/detail/timerwheel.h"
+
+using namespace cli::detail;
+using namespace std::chrono;
+
+BOOST_AUTO_TEST_SUITE(TimerWheelSuite)
+
+BOOST_AUTO_TEST_CASE(Basics)
+{
+    const auto t0 = steady_clock::now();
+    TimerWheel wheel(milliseconds(10), 8, t0);
+    std::vector<int> fired;
+    BOOST_CHECK(wheel.Empty());
+    wheel.Add(t0 + milliseconds(25), [&](){ fired.push_back(25); });
+    wheel.Add(t0 + milliseconds(10), [&](){ fired.push_back(10); });
+    wheel.Add(t0, [&](){ fired.push_back(0); }); // already expired: at the next tick
+    BOOST_CHECK_EQUAL(wheel.Size(), 3u);
+
+    BOOST_CHECK_EQUAL(wheel.Advance(t0 + milliseconds(9)), 0u);
+    BOOST_CHECK_EQUAL(wheel.Advance(t0 + milliseconds(10)), 2u);
+    BOOST_CHECK((fired == std::vector<int>{0, 10}) || (fired == std::vector<int>{10, 0}));
+    BOOST_CHECK_EQUAL(wheel.Advance(t0 + milliseconds(29)), 0u);
+    BOOST_CHECK_EQUAL(wheel.Advance(t0 + milliseconds(30)), 1u); // rounded up to the tick
+    BOOST_CHECK_EQUAL(fired.back(), 25);
+    BOOST_CHECK(wheel.Empty());
+}
+
+BOOST_AUTO_TEST_CASE(BeyondTheWheel)
+{
+    const auto t0 = steady_clock::now();
+    TimerWheel wheel(milliseconds(10), 4, t0); // a turn is 40ms
+    int fired = 0;
+    wheel.Add(t0 + milliseconds(100), [&](){ ++fired; });
+    wheel.Add(t0 + milliseconds(20), [&](){ ++fired; });
+    BOOST_CHECK_EQUAL(wheel.Advance(t0 + milliseconds(90)), 1u);
+    BOOST_CHECK_EQUAL(fired, 1);
+    BOOST_CHECK_EQUAL(wheel.Advance(t0 + milliseconds(99)), 0u);
+    BOOST_CHECK_EQUAL(wheel.Advance(t0 + milliseconds(100)), 1u);
+    BOOST_CHECK_EQUAL(fired, 2);
+
+    // a long pause runs everything expired in the meantime
+    wheel.Add(t0 + milliseconds(150), [&](){ ++fired; });
+    wheel.Add(t0 + milliseconds(500), [&](){ ++fired; });
+    BOOST_CHECK_EQUAL(wheel.Advance(t0 + seconds(10)), 2u);
+    BOOST_CHECK_EQUAL(fired, 4);
+}
+
+BOOST_AUTO_TEST_CASE(Cancel)
+{
+    const auto t0 = steady_clock::now();
+    TimerWheel wheel(milliseconds(10), 16, t0);
+    int fired = 0;
+    const auto a = wheel.Add(t0 + milliseconds(50), [&](){ fired += 1; });
+    const auto b = wheel.Add(t0 + milliseconds(50), [&](){ fired += 10; });
+    const auto c = wheel.Add(t0 + milliseconds(50), [&](){ fired += 100; });
+    BOOST_CHECK(wheel.Cancel(b));
+    BOOST_CHECK(!wheel.Cancel(b));
+    BOOST_CHECK(!wheel.Cancel(0));
+    BOOST_CHECK_EQUAL(wheel.Size(), 2u);
+
+    // the entry of b is reused, but the old handle does not refer to it
+    const auto d = wheel.Add(t0 + milliseconds(50), [&](){ fired += 1000; });
+    BOOST_CHECK(d != b);
+    BOOST_CHECK(!wheel.Cancel(b));
+
+    wheel.Advance(t0 + milliseconds(50));
+    BOOST_CHECK_EQUAL(fired, 1101);
+    BOOST_CHECK(!wheel.Cancel(a));
+    BOOST_CHECK(!wheel.Cancel(c));
+    BOOST_CHECK(wheel.Empty());
+}
+
+BOOST_AUTO_TEST_CASE(Reschedule)
+{
+    // a function can add and cancel deadlines (e.g., postpone itself)
+    const auto t0 = steady_clock::now();
+    TimerWheel wheel(milliseconds(10), 4, t0);
+    std::vector<steady_clock::time_point> runs;
+    TimerWheel::Handle other = wheel.Add(t0 + milliseconds(30), [&](){ runs.push_back(t0); });
+    std::function<void()> f = [&]()
+    {
+        runs.push_back(wheel.Next());
+        wheel.Cancel(other);
+        if (runs.size() < 3)
+            wheel.Add(wheel.Next() + milliseconds(20), f);
+    };
+    wheel.Add(t0 + milliseconds(10), f);
+    wheel.Advance(t0 + seconds(1));
+    BOOST_REQUIRE_EQUAL(runs.size(), 3u);
+    BOOST_CHECK(runs[0] == t0 + milliseconds(20));
+    BOOST_CHECK(runs[1] == t0 + milliseconds(50));
+    BOOST_CHECK(runs[2] == t0 + milliseconds(80));
+    BOOST_CHECK(wheel.Empty());
+}
+
+BOOST_AUTO_TEST_CASE(RandomDeadlines)
+{
+    const auto t0 = steady_clock::now();
+    const auto tick = milliseconds(10);
+    TimerWheel wheel(tick, 64, t0);
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> delay(0, 5000);
+    std::map<TimerWheel::Handle, steady_clock::time_point> pending;
+    std::size_t late = 0;
+    std::size_t early = 0;
+    steady_clock::time_point now = t0;
+    for (int i = 0; i < 20000; ++i)
+    {
+        const auto deadline = now + milliseconds(delay(gen));
+        auto h = std::make_shared<TimerWheel::Handle>(0);
+        *h = wheel.Add(deadline, [&, h, deadline]()
+        {
+            const auto expiry = wheel.Next() - tick; // the tick running
+            if (expiry < deadline || now < deadline)
+                ++early;
+            if (expiry > deadline + tick)
+                ++late;
+            pending.erase(*h);
+        });
+        pending[*h] = deadline;
+        if (i % 3 == 0)
+        {
+            // cancel a random one
+            auto victim = pending.begin();
+            std::advance(victim, static_cast<long>(gen() % pending.size()));
+            BOOST_CHECK(wheel.Cancel(victim->first));
+            pending.erase(victim);
+        }
+        if (i % 10 == 0)
+        {
+            now += milliseconds(gen() % 30);
+            wheel.Advance(now);
+        }
+    }
+    BOOST_CHECK_EQUAL(wheel.Size(), pending.size());
+    now += seconds(10);
+    wheel.Advance(now);
+    BOOST_CHECK(wheel.Empty());
+    BOOST_CHECK(pending.empty());
+    BOOST_CHECK_EQUAL(early, 0u);
+    BOOST_CHECK_EQUAL(late, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()